@@ -20,6 +20,7 @@ const char* filename_add = "data/ExtractedCircuitAdd.txt";
 // returns the proving time and number of keccaks proved
 
 int num_thread;
+int num_thread_per_proof = 1;
 Circuit<F, F_primitive> *circuits;
 
 void load_circuit(int i)
@@ -48,7 +49,7 @@ int main(int argc, char* argv[])
         if (argc <= 1)
         {
             num_thread = 4;
-            std::cout << "Use ./keccak_benchmark number_of_threads. Default to 4." << std::endl;        
+            std::cout << "Use ./keccak_benchmark number_of_threads [number_of_threads_per_proof]. Default to 4." << std::endl;        
         }
         else 
         {
@@ -59,16 +60,26 @@ int main(int argc, char* argv[])
                 return 1;
             }
         }
+        if (argc > 2)
+        {
+            num_thread_per_proof = atoi(argv[2]);
+            if (num_thread_per_proof == 0)
+            {
+                std::cout << "Argumemt #2 number_of_threads_per_proof is incorrect." << std::endl;
+                return 1;
+            }
+        }
     }
     else 
     {
         num_thread = 1;
     }
-    std::cout << "Benchmarking with " << num_thread << " threads" << std::endl;
+    std::cout << "Benchmarking with " << num_thread << " threads, " << num_thread_per_proof << " threads per proof" << std::endl;
 
     circuits = new Circuit<F, F_primitive>[num_thread];
 
     Config local_config;
+    local_config.nb_threads = num_thread_per_proof;
     printf("Default parallel repetition config %d\n", local_config.get_num_repetitions());
     std::vector<std::thread> threads(num_thread);
     int *partial_proofs = new int[num_thread];
@@ -2,9 +2,14 @@
 
 #include "circuit/circuit.hpp"
 #include "field/M31.hpp"
+#include "field/M31_ext3.hpp"
 #include "configuration/config.hpp"
 #include "gkr.hpp"
+#include "batch.hpp"
+#include "witness_batch.hpp"
 #include "poly_commit/raw.hpp"
+#include <memory>
+#include <optional>
 
 namespace gkr
 {
@@ -31,35 +36,88 @@ void grind(Transcript<F, F_primitive> &transcript, const Config &local_config)
     transcript.append_bytes(hash_bytes, 256/8);
 }
 
+// The field type a config proving over F_primitive names. The number of repetitions is derived from
+// it, so a config of the wrong field would leave the challenges of F_primitive short of the security level.
+template<typename F_primitive>
+constexpr Field_type field_type_of()
+{
+    if constexpr (std::is_same_v<F_primitive, M31_field::M31Ext3>)
+    {
+        return Field_type::M31Ext3;
+    }
+    else
+    {
+        static_assert(std::is_same_v<F_primitive, M31_field::M31>, "no config field type for this field");
+        return Field_type::M31;
+    }
+}
+
+// The circuit a proof is checked against. When it has random coefficients, they are drawn from the transcript
+// into a copy, so the caller's circuit is left as given and can check other proofs.
+// See Circuit::set_rand_coefs for the soundness of the checks built on them.
+template<typename F, typename F_primitive>
+const Circuit<F, F_primitive>& with_rand_coefs(const Circuit<F, F_primitive> &circuit, Transcript<F, F_primitive> &transcript,
+    std::optional<Circuit<F, F_primitive>> &copy)
+{
+    if (circuit.nb_rand_coefs() == 0)
+    {
+        return circuit;
+    }
+    copy.emplace(circuit);
+    copy->set_rand_coefs(transcript.challenge_fs(circuit.nb_rand_coefs()));
+    return *copy;
+}
+
 template<typename F, typename F_primitive>
 class Prover
 {
 public:
+    // the field of the witness and of the commitment, see WitnessField
+    using W = witness_field_t<F>;
+
     const Config &config;
-    GKRScratchPad<F, F_primitive>* scratch_pad;
+    // one per repetition, allocated by prepare_mem and released once the single circuit proof is done
+    std::unique_ptr<GKRScratchPad<F, F_primitive>[]> scratch_pad;
+    // the pool outlives single proofs so the workers are only spawned once
+    std::unique_ptr<ThreadPool> pool;
 
 public:
     Prover(const Config &config_): config(config_)
     {
-        assert(config.field_type == Field_type::M31);
+        assert(config.field_type == field_type_of<F_primitive>());
         assert(config.FS_hash == FiatShamir_hash_type::SHA256);
         assert(config.PC_type == Polynomial_commitment_type::Raw);
+        if (config.nb_threads > 1)
+        {
+            pool = std::make_unique<ThreadPool>(config.nb_threads);
+        }
     }
 
-    void prepare_mem(const Circuit<F, F_primitive>& circuit)
+    // one scratch pad per repetition, sized for the circuit
+    std::unique_ptr<GKRScratchPad<F, F_primitive>[]> new_scratch_pads(const Circuit<F, F_primitive>& circuit) const
     {
-        scratch_pad = new GKRScratchPad<F, F_primitive>[config.get_num_repetitions()];
-        for(int i = 0; i < config.get_num_repetitions(); i++)
+        uint32 nb_repetitions = config.get_num_repetitions();
+        assert(nb_repetitions > 0);
+        auto pads = std::make_unique<GKRScratchPad<F, F_primitive>[]>(nb_repetitions);
+        for(uint32 i = 0; i < nb_repetitions; i++)
         {
-            scratch_pad[i].prepare(circuit);
+            pads[i].prepare(circuit, pool.get());
         }
+        return pads;
+    }
+
+    // Needed before each prove(circuit). The batched proofs allocate their own scratch pads.
+    void prepare_mem(const Circuit<F, F_primitive>& circuit)
+    {
+        scratch_pad = new_scratch_pads(circuit);
     }
 
-    std::tuple<std::vector<F>, Proof<F>> prove(const Circuit<F, F_primitive>& circuit)
+    // The circuit is evaluated again when it has random coefficients, they are only known once the input is committed
+    std::tuple<std::vector<F>, Proof<F>> prove(Circuit<F, F_primitive>& circuit)
     {
         // pc commit
-        RawPC<F, F_primitive> raw_pc;
-        RawCommitment<F> commitment = raw_pc.commit(circuit.layers[0].input_layer_vals.evals);
+        RawPC<W, F_primitive> raw_pc;
+        RawCommitment<W> commitment = raw_pc.commit(circuit.layers[0].input_layer_vals.evals);
         uint8* buffer = (uint8*) scratch_pad[0].v_evals;
         commitment.to_bytes(buffer);
         Transcript<F, F_primitive> transcript;
@@ -67,27 +125,119 @@ public:
 
         //grinding
         grind(transcript, config);
+        if (circuit.nb_rand_coefs() > 0)
+        {
+            circuit.set_rand_coefs(transcript.challenge_fs(circuit.nb_rand_coefs()));
+            circuit.evaluate();
+        }
         // gkr
-        auto t = gkr_prove<F, F_primitive>(circuit, scratch_pad, transcript, config);
+        auto t = gkr_prove<F, F_primitive>(circuit, scratch_pad.get(), transcript, config);
         
-        // open
+        // the two claims of each repetition, and the lookup one if any, are combined into one, which is opened
         auto claimed_v = std::get<0>(t);
-        auto rz1s = std::get<1>(t);
-        auto rz2s = std::get<2>(t);
+        auto rs = sumcheck_prove_combine_claims<F, F_primitive>(circuit.layers[0], std::get<1>(t), std::get<2>(t), transcript, scratch_pad.get(), config, std::get<3>(t));
         for(int i = 0; i < config.get_num_repetitions(); i++)
         {
-            RawOpening opening1 = raw_pc.open(rz1s[i]);
-            opening1.to_bytes(buffer);
-            transcript.append_bytes(buffer, opening1.size());
-
-            RawOpening opening2 = raw_pc.open(rz2s[i]);
-            opening2.to_bytes(buffer);
-            transcript.append_bytes(buffer, opening2.size());
+            RawOpening opening = raw_pc.open(rs[i]);
+            opening.to_bytes(buffer);
+            transcript.append_bytes(buffer, opening.size());
         }
-        delete [] scratch_pad;
+        scratch_pad.reset();
         
         return {claimed_v, transcript.proof};
     }
+
+    // Proves several circuits of any shapes in one transcript, with one grinding, one commitment to
+    // their stacked inputs and one opening, see BatchInputLayout. Returns the claimed outputs of each circuit.
+    // Each circuit gets its own scratch pads, the ones of prepare_mem are left untouched.
+    std::tuple<std::vector<std::vector<F>>, Proof<F>> prove(std::vector<Circuit<F, F_primitive>>& circuits)
+    {
+        BatchInputLayout layout = BatchInputLayout::of(circuits);
+        std::vector<const std::vector<W>*> inputs;
+        for (const Circuit<F, F_primitive>& circuit: circuits)
+        {
+            inputs.emplace_back(&circuit.layers[0].input_layer_vals.evals);
+        }
+        std::vector<W> stacked = layout.stack(inputs);
+
+        // pc commit
+        RawPC<W, F_primitive> raw_pc;
+        RawCommitment<W> commitment = raw_pc.commit(stacked);
+        std::vector<uint8> buffer(commitment.size());
+        commitment.to_bytes(buffer.data());
+        Transcript<F, F_primitive> transcript;
+        transcript.append_bytes(buffer.data(), commitment.size());
+
+        //grinding
+        grind(transcript, config);
+        for (Circuit<F, F_primitive>& circuit: circuits)
+        {
+            if (circuit.nb_rand_coefs() > 0)
+            {
+                circuit.set_rand_coefs(transcript.challenge_fs(circuit.nb_rand_coefs()));
+                circuit.evaluate();
+            }
+        }
+
+        // gkr, one circuit after the other, the claims of each on its input combined into one per repetition
+        std::vector<std::vector<F>> claimed_v;
+        std::vector<std::vector<std::vector<F_primitive>>> rs;
+        for (Circuit<F, F_primitive>& circuit: circuits)
+        {
+            auto pads = new_scratch_pads(circuit);
+            auto t = gkr_prove<F, F_primitive>(circuit, pads.get(), transcript, config);
+            claimed_v.emplace_back(std::get<0>(t));
+            rs.emplace_back(sumcheck_prove_combine_claims<F, F_primitive>(circuit.layers[0], std::get<1>(t), std::get<2>(t), transcript, pads.get(), config, std::get<3>(t)));
+        }
+
+        std::vector<F> lifted;
+        auto r = batch_prove_input_claims<F, F_primitive>(layout, lift_table(stacked, lifted), rs, transcript, config, pool.get());
+        for(int i = 0; i < config.get_num_repetitions(); i++)
+        {
+            RawOpening opening = raw_pc.open(r[i]);
+            opening.to_bytes(buffer.data());
+            transcript.append_bytes(buffer.data(), opening.size());
+        }
+        return {claimed_v, transcript.proof};
+    }
+
+    // Proves the circuit on a power of two number of witnesses in one proof, with one commitment to the
+    // stacked witnesses, see WitnessBatch. The circuit is left evaluated on the last witness.
+    // The circuit has no lookup. The batch sumchecks keep their tables in WitnessBatch, no scratch pad is used.
+    std::tuple<std::vector<F>, Proof<F>> prove(Circuit<F, F_primitive>& circuit, const std::vector<std::vector<W>>& witnesses)
+    {
+        assert(circuit.lookup.empty());
+        std::vector<W> stacked = WitnessBatch<F, F_primitive>::stack(witnesses);
+
+        // pc commit
+        RawPC<W, F_primitive> raw_pc;
+        RawCommitment<W> commitment = raw_pc.commit(stacked);
+        std::vector<uint8> buffer(commitment.size());
+        commitment.to_bytes(buffer.data());
+        Transcript<F, F_primitive> transcript;
+        transcript.append_bytes(buffer.data(), commitment.size());
+
+        //grinding
+        grind(transcript, config);
+        if (circuit.nb_rand_coefs() > 0)
+        {
+            circuit.set_rand_coefs(transcript.challenge_fs(circuit.nb_rand_coefs()));
+        }
+        WitnessBatch<F, F_primitive> batch;
+        batch.evaluate(circuit, witnesses);
+
+        // gkr
+        auto [claimed_v, rz1, rz2, rb] = gkr_prove_batch<F, F_primitive>(circuit, batch, transcript, config, pool.get());
+        std::vector<F> lifted;
+        auto rs = batch_prove_witness_claims<F, F_primitive>(lift_table(stacked, lifted), rz1, rz2, rb, transcript, config, pool.get());
+        for(int i = 0; i < config.get_num_repetitions(); i++)
+        {
+            RawOpening opening = raw_pc.open(rs[i]);
+            opening.to_bytes(buffer.data());
+            transcript.append_bytes(buffer.data(), opening.size());
+        }
+        return {claimed_v, transcript.proof};
+    }
 };
 
 class Verifier
@@ -101,15 +251,21 @@ public:
         
     }
 
+    // The random coefficients of the circuit are drawn from the transcript, as by the prover
     template<typename F, typename F_primitive>
     bool verify(const Circuit<F, F_primitive>& circuit, const std::vector<F>& claimed_v, Proof<F>& proof)
     {
+        assert(config.field_type == field_type_of<F_primitive>());
+        if (!circuit.supports_rand_coefs())
+        {
+            return false;
+        }
         GKRScratchPad<F, F_primitive> scratch_pad;
         scratch_pad.prepare(circuit);
 
         // get commitment
         uint32 poly_size = circuit.layers[0].input_layer_vals.evals.size();
-        RawCommitment<F> commitment;
+        RawCommitment<witness_field_t<F>> commitment;
         commitment.from_bytes(proof.bytes_head(), poly_size);
 
         Transcript<F, F_primitive> transcript;
@@ -119,31 +275,139 @@ public:
         grind(transcript, config);
 
         proof.step(commitment.size() + 256/8);
+        std::optional<Circuit<F, F_primitive>> copy;
+        const Circuit<F, F_primitive>& proof_circuit = with_rand_coefs(circuit, transcript, copy);
 
         // gkr
-        auto t = gkr_verify<F, F_primitive>(circuit, claimed_v, transcript, proof, config);
+        auto t = gkr_verify<F, F_primitive>(proof_circuit, claimed_v, transcript, proof, config);
         
         // verify pc
         bool verified = std::get<0>(t);
-        auto rz1 = std::get<1>(t);
-        auto rz2 = std::get<2>(t);
-        auto claimed_v1 = std::get<3>(t);
-        auto claimed_v2 = std::get<4>(t);
+        auto c = sumcheck_verify_combine_claims<F, F_primitive>(proof_circuit.layers[0], std::get<1>(t), std::get<2>(t),
+            std::get<3>(t), std::get<4>(t), proof, transcript, config, std::get<5>(t), std::get<6>(t));
+        verified &= std::get<0>(c);
+        auto rs = std::get<1>(c);
+        auto v_claims = std::get<2>(c);
         for(int i = 0; i < config.get_num_repetitions(); i++)
         {
-            RawOpening opening1;
-            opening1.from_bytes(proof.bytes_head(), poly_size);
-            proof.step(opening1.size());
-
-            RawOpening opening2;
-            opening2.from_bytes(proof.bytes_head(), poly_size);
-            proof.step(opening2.size());
-            
-            RawPC<F, F_primitive> raw_pc;
-            std::cout << rz1[i].size() << std::endl;
-            std::cout << commitment.poly_vals.size() << std::endl;
-            verified &= raw_pc.verify(commitment, opening1, rz1[i], claimed_v1[i]);
-            verified &= raw_pc.verify(commitment, opening2, rz2[i], claimed_v2[i]);
+            RawOpening opening;
+            opening.from_bytes(proof.bytes_head(), poly_size);
+            proof.step(opening.size());
+
+            RawPC<witness_field_t<F>, F_primitive> raw_pc;
+            verified &= raw_pc.verify(commitment, opening, rs[i], v_claims[i]);
+        }
+        return verified;
+    }
+
+    // Checks a proof of Prover::prove for nb_witnesses witnesses of the circuit. The batch does not run
+    // the lookup, a circuit with one is rejected.
+    template<typename F, typename F_primitive>
+    bool verify(const Circuit<F, F_primitive>& circuit, uint32 nb_witnesses, const std::vector<F>& claimed_v, Proof<F>& proof)
+    {
+        assert(config.field_type == field_type_of<F_primitive>());
+        if (nb_witnesses != next_pow_of_2(nb_witnesses) || !circuit.supports_rand_coefs() || !circuit.lookup.empty())
+        {
+            return false;
+        }
+        uint32 nb_batch_vars = __builtin_ctz(nb_witnesses);
+        uint32 nb_vars = circuit.log_input_size() + nb_batch_vars;
+
+        // get commitment
+        RawCommitment<witness_field_t<F>> commitment;
+        commitment.from_bytes(proof.bytes_head(), 1 << nb_vars);
+
+        Transcript<F, F_primitive> transcript;
+        transcript.append_bytes(proof.bytes_head(), commitment.size());
+
+        //grinding
+        grind(transcript, config);
+
+        proof.step(commitment.size() + 256/8);
+        std::optional<Circuit<F, F_primitive>> copy;
+        const Circuit<F, F_primitive>& proof_circuit = with_rand_coefs(circuit, transcript, copy);
+
+        // gkr
+        auto [verified, rz1, rz2, rb, v1, v2] = gkr_verify_batch<F, F_primitive>(proof_circuit, nb_batch_vars, claimed_v, transcript, proof, config);
+
+        // verify pc
+        auto c = batch_verify_witness_claims<F, F_primitive>(nb_vars, rz1, rz2, rb, v1, v2, proof, transcript, config);
+        verified &= std::get<0>(c);
+        for(int i = 0; i < config.get_num_repetitions(); i++)
+        {
+            RawOpening opening;
+            opening.from_bytes(proof.bytes_head(), 1 << nb_vars);
+            proof.step(opening.size());
+
+            RawPC<witness_field_t<F>, F_primitive> raw_pc;
+            verified &= raw_pc.verify(commitment, opening, std::get<1>(c)[i], std::get<2>(c)[i]);
+        }
+        return verified;
+    }
+
+    // Checks a proof of Prover::prove for several circuits
+    template<typename F, typename F_primitive>
+    bool verify(const std::vector<Circuit<F, F_primitive>>& circuits, const std::vector<std::vector<F>>& claimed_v, Proof<F>& proof)
+    {
+        assert(config.field_type == field_type_of<F_primitive>());
+        if (circuits.size() != claimed_v.size())
+        {
+            return false;
+        }
+        for (const Circuit<F, F_primitive>& circuit: circuits)
+        {
+            if (!circuit.supports_rand_coefs())
+            {
+                return false;
+            }
+        }
+        BatchInputLayout layout = BatchInputLayout::of(circuits);
+
+        // get commitment
+        RawCommitment<witness_field_t<F>> commitment;
+        commitment.from_bytes(proof.bytes_head(), layout.size());
+
+        Transcript<F, F_primitive> transcript;
+        transcript.append_bytes(proof.bytes_head(), commitment.size());
+
+        //grinding
+        grind(transcript, config);
+
+        proof.step(commitment.size() + 256/8);
+        std::vector<std::optional<Circuit<F, F_primitive>>> copies(circuits.size());
+        std::vector<const Circuit<F, F_primitive>*> proof_circuits;
+        for (uint32 k = 0; k < circuits.size(); k++)
+        {
+            proof_circuits.emplace_back(&with_rand_coefs(circuits[k], transcript, copies[k]));
+        }
+
+        // gkr
+        bool verified = true;
+        std::vector<std::vector<std::vector<F_primitive>>> rs;
+        std::vector<std::vector<F>> v_claims;
+        for (uint32 k = 0; k < circuits.size(); k++)
+        {
+            const Circuit<F, F_primitive>& circuit = *proof_circuits[k];
+            auto t = gkr_verify<F, F_primitive>(circuit, claimed_v[k], transcript, proof, config);
+            verified &= std::get<0>(t);
+            auto c = sumcheck_verify_combine_claims<F, F_primitive>(circuit.layers[0], std::get<1>(t), std::get<2>(t),
+                std::get<3>(t), std::get<4>(t), proof, transcript, config, std::get<5>(t), std::get<6>(t));
+            verified &= std::get<0>(c);
+            rs.emplace_back(std::get<1>(c));
+            v_claims.emplace_back(std::get<2>(c));
+        }
+
+        // verify pc
+        auto b = batch_verify_input_claims<F, F_primitive>(layout, rs, v_claims, proof, transcript, config);
+        verified &= std::get<0>(b);
+        for(int i = 0; i < config.get_num_repetitions(); i++)
+        {
+            RawOpening opening;
+            opening.from_bytes(proof.bytes_head(), layout.size());
+            proof.step(opening.size());
+
+            RawPC<witness_field_t<F>, F_primitive> raw_pc;
+            verified &= raw_pc.verify(commitment, opening, std::get<1>(b)[i], std::get<2>(b)[i]);
         }
         return verified;
     }
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <numeric>
+#include "circuit/circuit.hpp"
+#include "configuration/config.hpp"
+#include "sumcheck_common.hpp"
+#include "sumcheck_virtual.hpp"
+
+namespace gkr
+{
+
+// Several circuits proven together commit to a single polynomial, their input layers stacked.
+// The inputs are placed by decreasing size, so the input of circuit k with n_k variables starts at
+// a multiple of 2^{n_k} and v_k(r) is the stacked polynomial at (r, bits of offset_k / 2^{n_k}).
+// The claims left on the inputs are then reduced to one claim on the stacked polynomial by the sumcheck of
+//  \sum_k a^k v_k(r_k) = \sum_x V(x) \sum_k a^k eq(p_k, x)
+// where eq(p_k, .) is zero outside of the input of circuit k.
+class BatchInputLayout
+{
+public:
+    std::vector<uint32> nb_input_vars;
+    std::vector<uint32> offsets;
+    uint32 nb_vars;
+
+    static BatchInputLayout of(const std::vector<uint32>& nb_input_vars)
+    {
+        BatchInputLayout layout;
+        layout.nb_input_vars = nb_input_vars;
+        layout.offsets.resize(nb_input_vars.size());
+        std::vector<uint32> order(nb_input_vars.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](uint32 a, uint32 b) { return nb_input_vars[a] > nb_input_vars[b]; });
+        uint32 size = 0;
+        for (uint32 k: order)
+        {
+            layout.offsets[k] = size;
+            size += 1 << nb_input_vars[k];
+        }
+        layout.nb_vars = __builtin_ctz(next_pow_of_2(size));
+        return layout;
+    }
+
+    template<typename F, typename F_primitive>
+    static BatchInputLayout of(const std::vector<Circuit<F, F_primitive>>& circuits)
+    {
+        std::vector<uint32> nb_input_vars;
+        for (const Circuit<F, F_primitive>& circuit: circuits)
+        {
+            nb_input_vars.emplace_back(circuit.log_input_size());
+        }
+        return of(nb_input_vars);
+    }
+
+    uint32 size() const
+    {
+        return 1 << nb_vars;
+    }
+
+    // The point of the stacked polynomial where it evaluates to v_k(r)
+    template<typename F_primitive>
+    std::vector<F_primitive> point(uint32 k, const std::vector<F_primitive>& r) const
+    {
+        std::vector<F_primitive> p = r;
+        uint32 block = offsets[k] >> nb_input_vars[k];
+        for (uint32 i = nb_input_vars[k]; i < nb_vars; i++)
+        {
+            p.emplace_back((block & 1) ? F_primitive::one() : F_primitive::zero());
+            block >>= 1;
+        }
+        return p;
+    }
+
+    template<typename F>
+    std::vector<F> stack(const std::vector<const std::vector<F>*>& inputs) const
+    {
+        std::vector<F> stacked(size(), F::zero());
+        for (uint32 k = 0; k < inputs.size(); k++)
+        {
+            std::copy(inputs[k]->begin(), inputs[k]->end(), stacked.begin() + offsets[k]);
+        }
+        return stacked;
+    }
+};
+
+// g_0 g_1, the stacked polynomial times the combined eq
+template<typename F>
+struct ProductCombine
+{
+    F operator()(const F* g) const
+    {
+        return g[0] * g[1];
+    }
+};
+
+// Reduces the claims at rs[k][j], circuit k and repetition j, to one claim per repetition on the
+// stacked polynomial, see BatchInputLayout. Returns the points of these claims, their values are appended.
+template<typename F, typename F_primitive>
+std::vector<std::vector<F_primitive>> batch_prove_input_claims(
+    const BatchInputLayout& layout,
+    const std::vector<F>& stacked,
+    const std::vector<std::vector<std::vector<F_primitive>>>& rs,
+    Transcript<F, F_primitive>& transcript,
+    const Config& config,
+    ThreadPool* pool = nullptr
+)
+{
+    std::vector<std::vector<F_primitive>> r(config.get_num_repetitions());
+    for (int j = 0; j < config.get_num_repetitions(); j++)
+    {
+        F_primitive a = transcript.challenge_f();
+        std::vector<F> eq_sum(layout.size(), F::zero());
+        F_primitive a_k = F_primitive::one();
+        for (uint32 k = 0; k < rs.size(); k++)
+        {
+            std::vector<F_primitive> eq_r(1 << layout.nb_input_vars[k]);
+            _eq_evals_at_primitive(rs[k][j], a_k, eq_r.data());
+            for (uint32 x = 0; x < eq_r.size(); x++)
+            {
+                eq_sum[layout.offsets[k] + x] = F::zero() + eq_r[x];
+            }
+            a_k *= a;
+        }
+        r[j] = std::get<0>(sumcheck_prove_virtual<F, F_primitive>({stacked.data(), eq_sum.data()}, layout.nb_vars, 2, ProductCombine<F>{}, transcript, pool));
+    }
+    return r;
+}
+
+// Checks a proof of batch_prove_input_claims for the claims v[k][j] at rs[k][j].
+// Returns {verified, r, V(r)}, V(r) is left to the opening
+template<typename F, typename F_primitive>
+std::tuple<bool, std::vector<std::vector<F_primitive>>, std::vector<F>> batch_verify_input_claims(
+    const BatchInputLayout& layout,
+    const std::vector<std::vector<std::vector<F_primitive>>>& rs,
+    const std::vector<std::vector<F>>& v,
+    Proof<F>& proof,
+    Transcript<F, F_primitive>& transcript,
+    const Config& config
+)
+{
+    bool verified = true;
+    std::vector<std::vector<F_primitive>> r(config.get_num_repetitions());
+    std::vector<F> v_stacked(config.get_num_repetitions());
+    for (int j = 0; j < config.get_num_repetitions(); j++)
+    {
+        F_primitive a = transcript.challenge_f();
+        F sum = F::zero();
+        F_primitive a_k = F_primitive::one();
+        std::vector<F_primitive> a_ks;
+        for (uint32 k = 0; k < rs.size(); k++)
+        {
+            sum += v[k][j] * a_k;
+            a_ks.emplace_back(a_k);
+            a_k *= a;
+        }
+        auto [sumcheck_verified, r_j, evals] = sumcheck_verify_virtual<F, F_primitive>(layout.nb_vars, 2, 2, sum, ProductCombine<F>{}, proof, transcript);
+        F_primitive eq_sum = F_primitive::zero();
+        for (uint32 k = 0; k < rs.size(); k++)
+        {
+            eq_sum += a_ks[k] * _eq_at(layout.point(k, rs[k][j]), r_j);
+        }
+        verified &= sumcheck_verified && evals[1] == F::zero() + eq_sum;
+        r[j] = r_j;
+        v_stacked[j] = evals[0];
+    }
+    return {verified, r, v_stacked};
+}
+
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "circuit/circuit.hpp"
+#include "sumcheck_common.hpp"
+#include "field/M31.hpp"
+
+#ifdef __AVX512F__
+#include <immintrin.h>
+#endif
+
+namespace gkr
+{
+
+// Gates are accumulated in blocks of about this many, small enough for the weights to stay in L1
+const uint32 GATE_BLOCK_SIZE = 256;
+
+// weights[i - begin] = (eq_rz1[z] + eq_rz2[z]) * eq_other[other] * coef for the gates [begin, end) of csr,
+// where eq_other is only applied when it is not null
+template<CoefType ct, typename F_primitive>
+void gate_weights(const GateCSR<F_primitive>& csr, uint32 begin, uint32 end,
+    const EqSqrtView<F_primitive>& eq_rz1, const EqSqrtView<F_primitive>& eq_rz2, const EqSqrtView<F_primitive>* eq_other,
+    F_primitive* weights)
+{
+    for (uint32 i = begin; i < end; i++)
+    {
+        uint32 z = csr.o_ids[i];
+        F_primitive w = eq_rz1[z] + eq_rz2[z];
+        if (eq_other != nullptr)
+        {
+            w = w * (*eq_other)[csr.other_ids[i]];
+        }
+        weights[i - begin] = mul_coef<ct>(w, csr.coefs[i]);
+    }
+}
+
+#ifdef __AVX512F__
+
+namespace avx512
+{
+
+const __m512i packed_mod = _mm512_set1_epi32(M31_field::mod);
+const __m512i packed_mod_epi64 = _mm512_set1_epi64(M31_field::mod);
+
+// 16 lane versions of the PackedM31 operations, see M31_avx.tcc
+inline __m512i m31_add(__m512i a, __m512i b)
+{
+    __m512i r = _mm512_add_epi32(a, b);
+    return _mm512_mask_sub_epi32(r, _mm512_cmpge_epu32_mask(r, packed_mod), r, packed_mod);
+}
+
+inline __m512i m31_neg(__m512i a)
+{
+    return _mm512_mask_sub_epi32(a, _mm512_cmpneq_epu32_mask(a, _mm512_setzero_si512()), packed_mod, a);
+}
+
+inline __m512i m31_mul(__m512i a, __m512i b)
+{
+    __m512i even = _mm512_mul_epu32(a, b);
+    __m512i odd = _mm512_mul_epu32(_mm512_srli_epi64(a, 32), _mm512_srli_epi64(b, 32));
+    even = _mm512_add_epi64(_mm512_and_si512(even, packed_mod_epi64), _mm512_srli_epi64(even, 31));
+    odd = _mm512_add_epi64(_mm512_and_si512(odd, packed_mod_epi64), _mm512_srli_epi64(odd, 31));
+    __m512i r = _mm512_or_si512(even, _mm512_slli_epi64(odd, 32));
+    return _mm512_add_epi32(_mm512_and_si512(r, packed_mod), _mm512_srli_epi32(r, 31));
+}
+
+// eq(r, z) of 16 indices at once, gathered from the two halves of the view
+inline __m512i eq_gather(const EqSqrtView<M31_field::M31>& eq, __m512i z)
+{
+    __m512i lo = _mm512_and_si512(z, _mm512_set1_epi32(eq.first_mask));
+    __m512i hi = _mm512_srli_epi32(z, eq.first_bits);
+    __m512i first = _mm512_i32gather_epi32(lo, reinterpret_cast<const int*>(eq.first), 4);
+    __m512i second = _mm512_i32gather_epi32(hi, reinterpret_cast<const int*>(eq.second), 4);
+    return m31_mul(first, second);
+}
+
+} // namespace avx512
+
+// 16 gates per iteration: the eq values are gathered and combined with packed M31 arithmetic.
+// The gates are grouped by their accumulation target, so there are no scatter conflicts to resolve.
+template<CoefType ct>
+void gate_weights(const GateCSR<M31_field::M31>& csr, uint32 begin, uint32 end,
+    const EqSqrtView<M31_field::M31>& eq_rz1, const EqSqrtView<M31_field::M31>& eq_rz2, const EqSqrtView<M31_field::M31>* eq_other,
+    M31_field::M31* weights)
+{
+    static_assert(sizeof(M31_field::M31) == sizeof(uint32));
+    uint32 i = begin;
+    for (; i + 16 <= end; i += 16)
+    {
+        __m512i z = _mm512_loadu_si512(csr.o_ids.data() + i);
+        __m512i w = avx512::m31_add(avx512::eq_gather(eq_rz1, z), avx512::eq_gather(eq_rz2, z));
+        if (eq_other != nullptr)
+        {
+            __m512i other = _mm512_loadu_si512(csr.other_ids.data() + i);
+            w = avx512::m31_mul(w, avx512::eq_gather(*eq_other, other));
+        }
+        if constexpr (ct == CoefType::NegUnit)
+        {
+            w = avx512::m31_neg(w);
+        }
+        else if constexpr (ct == CoefType::General)
+        {
+            w = avx512::m31_mul(w, _mm512_loadu_si512(csr.coefs.data() + i));
+        }
+        _mm512_storeu_si512(weights + (i - begin), w);
+    }
+
+    for (; i < end; i++)
+    {
+        uint32 z = csr.o_ids[i];
+        M31_field::M31 w = eq_rz1[z] + eq_rz2[z];
+        if (eq_other != nullptr)
+        {
+            w = w * (*eq_other)[csr.other_ids[i]];
+        }
+        weights[i - begin] = mul_coef<ct>(w, csr.coefs[i]);
+    }
+}
+
+#endif
+
+} // namespace gkr
@@ -3,6 +3,7 @@
 #include<vector>
 #include "scratch_pad.hpp"
 #include "sumcheck.hpp"
+#include "logup.hpp"
 #include "circuit/circuit.hpp"
 #include <map>
 #include "configuration/config.hpp"
@@ -21,8 +22,10 @@ namespace gkr
 {
 
 
+// Returns the claimed outputs and the points rz1, rz2 of the claims left on the input layer,
+// followed by the points rq of the lookup claims, empty without a lookup
 template<typename F, typename F_primitive>
-std::tuple<std::vector<F>, std::vector<std::vector<F_primitive>>, std::vector<std::vector<F_primitive>>> gkr_prove(
+std::tuple<std::vector<F>, std::vector<std::vector<F_primitive>>, std::vector<std::vector<F_primitive>>, std::vector<std::vector<F_primitive>>> gkr_prove(
     const Circuit<F, F_primitive> &circuit, 
     GKRScratchPad<F, F_primitive> *scratch_pad,
     Transcript<F, F_primitive> &transcript,
@@ -68,12 +71,24 @@ std::tuple<std::vector<F>, std::vector<std::vector<F_primitive>>, std::vector<st
         rz2 = std::get<1>(t);
         timer.report_timing(string("layer " + to_string(i) + " sumcheck layer input size ") + std::to_string(circuit.layers[i].nb_input_vars) + string(" output size ") + std::to_string(circuit.layers[i].nb_output_vars));
     }
+
+    std::vector<std::vector<F_primitive>> rq;
+    if (!circuit.lookup.empty())
+    {
+        timer.add_timing("lookup");
+        std::vector<F> lifted_input;
+        rq = logup_prove(circuit.lookup, lift_table(circuit.layers[0].input_layer_vals.evals, lifted_input), transcript, config, scratch_pad[0].pool);
+        timer.report_timing("lookup");
+    }
     timer.report_timing("start proof");
-    return {claimed_v, rz1, rz2};
+    return {claimed_v, rz1, rz2, rq};
 }
 
+// Returns {verified, rz1, rz2, v(rz1), v(rz2), rq, v(rq)}, the claims left on the input layer,
+// where the lookup claims rq, v(rq) are empty without a lookup
 template<typename F, typename F_primitive>
-std::tuple<bool, std::vector<std::vector<F_primitive>>, std::vector<std::vector<F_primitive>>, std::vector<F>, std::vector<F> > gkr_verify(
+std::tuple<bool, std::vector<std::vector<F_primitive>>, std::vector<std::vector<F_primitive>>, std::vector<F>, std::vector<F>,
+    std::vector<std::vector<F_primitive>>, std::vector<F> > gkr_verify(
     const Circuit<F, F_primitive>& circuit,
     const std::vector<F>& claimed_v,
     Transcript<F, F_primitive>& transcript,
@@ -118,7 +133,17 @@ std::tuple<bool, std::vector<std::vector<F_primitive>>, std::vector<std::vector<
         claimed_v1 = std::get<3>(t);
         claimed_v2 = std::get<4>(t);
     }
-    return {verified, rz1, rz2, claimed_v1, claimed_v2};
+
+    std::vector<std::vector<F_primitive>> rq;
+    std::vector<F> claimed_vq;
+    if (!circuit.lookup.empty())
+    {
+        auto lookup_t = logup_verify(circuit.lookup, circuit.layers[0].nb_input_vars, proof, transcript, config);
+        verified &= std::get<0>(lookup_t);
+        rq = std::get<1>(lookup_t);
+        claimed_vq = std::get<2>(lookup_t);
+    }
+    return {verified, rz1, rz2, claimed_v1, claimed_v2, rq, claimed_vq};
 }
 
 }
\ No newline at end of file
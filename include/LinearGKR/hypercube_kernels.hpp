@@ -0,0 +1,147 @@
+#pragma once
+
+#include "utils/myutil.hpp"
+#include "field/M31.hpp"
+
+#if defined(__AVX512F__) && defined(__AVX512VL__)
+#include <immintrin.h>
+
+// With F = M31 a single circuit instance is proven, the bookkeeping tables have one element per entry.
+// These kernels vectorize along the hypercube instead: 8 consecutive entries, i.e. 4 pairs, are the
+// lanes of a PackedM31 and the sums are reduced horizontally. Gate bits select the lanes with masks.
+#define GKR_HYPERCUBE_SIMD
+
+namespace gkr
+{
+
+namespace hypercube
+{
+
+using M31_field::M31;
+using M31_field::PackedM31;
+
+static_assert(sizeof(M31) == sizeof(uint32));
+
+inline PackedM31 load(const M31* p)
+{
+    return PackedM31::new_unchecked(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+}
+
+// Lanes not in mask are zero and their memory is not touched
+inline PackedM31 load(const M31* p, __mmask8 mask)
+{
+    return PackedM31::new_unchecked(_mm256_maskz_loadu_epi32(mask, p));
+}
+
+inline void store(M31* p, const PackedM31& x)
+{
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), x.x);
+}
+
+// Lanes 2j and 2j + 1 swapped, x + swap_pairs(x) holds the sum of each pair in both of its lanes
+inline PackedM31 swap_pairs(const PackedM31& x)
+{
+    return PackedM31::new_unchecked(_mm256_shuffle_epi32(x.x, 0xB1));
+}
+
+// The sum of the lanes selected by mask
+inline M31 sum_lanes(const PackedM31& x, __mmask8 mask)
+{
+    return PackedM31::new_unchecked(_mm256_maskz_mov_epi32(mask, x.x)).sum_packed();
+}
+
+// Both entries of every pair holding a set bit
+inline __mmask8 pair_lanes(uint32 bits)
+{
+    uint32 pairs = (bits | (bits >> 1)) & 0x55;
+    return static_cast<__mmask8>(pairs | (pairs << 1));
+}
+
+// The even and the odd entries of the 16 from a, b
+inline void deinterleave(const PackedM31& a, const PackedM31& b, PackedM31& even, PackedM31& odd)
+{
+    const __m256i even_idx = _mm256_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14);
+    const __m256i odd_idx = _mm256_setr_epi32(1, 3, 5, 7, 9, 11, 13, 15);
+    even = PackedM31::new_unchecked(_mm256_permutex2var_epi32(a.x, even_idx, b.x));
+    odd = PackedM31::new_unchecked(_mm256_permutex2var_epi32(a.x, odd_idx, b.x));
+}
+
+// p0 += f(0) hg(0), p1 += f(1) hg(1), p2 += (f(0) + f(1)) (hg(0) + hg(1)) over the pairs of one bitset word,
+// i.e. entries [w * 64, w * 64 + 64). hg is masked by the gate bits and f by the pairs holding one,
+// so every lane is multiplied and nothing outside the pairs with a gate is read.
+inline void accumulate_word(uint32 w, uint64 word, const M31* f, const M31* hg, Accumulator<M31>& p0, Accumulator<M31>& p1, Accumulator<M31>& p2)
+{
+    PackedM31 p01 = PackedM31::zero();
+    PackedM31 p2_pairs = PackedM31::zero();
+    for (uint32 c = 0; c < 8; c++)
+    {
+        uint32 bits = (word >> (8 * c)) & 0xFF;
+        if (bits == 0)
+        {
+            continue;
+        }
+        uint32 i = w * 64 + 8 * c;
+        PackedM31 f_v = load(f + i, pair_lanes(bits));
+        PackedM31 hg_v = load(hg + i, static_cast<__mmask8>(bits));
+        p01 += f_v * hg_v;
+        p2_pairs += (f_v + swap_pairs(f_v)) * (hg_v + swap_pairs(hg_v));
+    }
+    p0.add(sum_lanes(p01, 0x55));
+    p1.add(sum_lanes(p01, 0xAA));
+    p2.add(sum_lanes(p2_pairs, 0x55));
+}
+
+// dst[i] = src[2i] + (src[2i + 1] - src[2i]) r for the i from begin on, 8 at a time as long as a
+// group fits below end. Returns the first i left to the caller. May fold in place, dst = src.
+inline uint32 fold_range(const M31* src, M31* dst, uint32 begin, uint32 end, const M31& r)
+{
+    uint32 i = begin;
+    for (; i + 8 <= end; i += 8)
+    {
+        PackedM31 f_0, f_1;
+        deinterleave(load(src + 2 * i), load(src + 2 * i + 8), f_0, f_1);
+        store(dst + i, f_0 + (f_1 - f_0) * r);
+    }
+    return i;
+}
+
+// dst[b / 2] = hg(0) + (hg(1) - hg(0)) r for the pairs with a gate of one bitset word, src points at
+// the first entry of the word. A missing hg entry counts as zero, dst is only written at the pairs with a gate.
+inline void fold_word(uint64 word, const M31* src, M31* dst, const M31& r)
+{
+    uint64 pairs = fold_bit_pairs(word);
+    for (uint32 c = 0; c < 4; c++)
+    {
+        uint32 bits = (word >> (16 * c)) & 0xFFFF;
+        if (bits == 0)
+        {
+            continue;
+        }
+        PackedM31 hg_0, hg_1;
+        deinterleave(load(src + 16 * c, static_cast<__mmask8>(bits)), load(src + 16 * c + 8, static_cast<__mmask8>(bits >> 8)), hg_0, hg_1);
+        PackedM31 folded = hg_0 + (hg_1 - hg_0) * r;
+        _mm256_mask_storeu_epi32(dst + 8 * c, static_cast<__mmask8>(pairs >> (8 * c)), folded.x);
+    }
+}
+
+// out[i] = v[ids[i]] * w[i] for i in [0, n), 8 at a time with a gather
+inline void gather_mul(const M31* v, const uint32* ids, const M31* w, uint32 n, M31* out)
+{
+    uint32 i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i idx = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ids + i));
+        PackedM31 v_y = PackedM31::new_unchecked(_mm256_i32gather_epi32(reinterpret_cast<const int*>(v), idx, 4));
+        store(out + i, v_y * load(w + i));
+    }
+    for (; i < n; i++)
+    {
+        out[i] = v[ids[i]] * w[i];
+    }
+}
+
+} // namespace hypercube
+
+} // namespace gkr
+
+#endif
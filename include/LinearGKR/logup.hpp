@@ -0,0 +1,263 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include "circuit/circuit.hpp"
+#include "configuration/config.hpp"
+#include "sumcheck_common.hpp"
+#include "sumcheck_virtual.hpp"
+
+namespace gkr
+{
+
+// LogUp: the values q_i of the input layer all belong to the table t iff, for a random alpha,
+//  \sum_i 1 / (alpha - q_i) = \sum_j m_j / (alpha - t_j)
+// where m_j counts the queries equal to t_j. Both sides are leaves of one tree of fractions p / q,
+// 1 / (alpha - q_i) for the queries and -m_j / (alpha - t_j) for the table, whose root must be zero.
+// Each level adds the fractions pairwise,
+//  p'(x) = p(0, x) q(1, x) + p(1, x) q(0, x), q'(x) = q(0, x) q(1, x)
+// and is reduced to the one below by a degree 3 sumcheck of
+//  p'(r) + lambda q'(r) = \sum_x eq(r, x) (p(0, x) q(1, x) + p(1, x) q(0, x) + lambda q(0, x) q(1, x))
+// The leaves have max(nb query vars, nb table vars) + 1 variables, the last one tells queries from
+// table entries, and the unused leaves are 0 / 1. The claim left on the queries is a claim on the
+// input layer, combined with those of the layers, see sumcheck_prove_combine_claims.
+
+// Values are compared by representation, the fields keep their elements reduced
+template<typename F_primitive>
+std::string _lookup_key(const F_primitive& v)
+{
+    return std::string(reinterpret_cast<const char*>(&v), sizeof(F_primitive));
+}
+
+// m_j, lane by lane: lane l of m_j counts the queries whose lane l is t_j.
+// A query missing from the table is not counted, the proof then fails.
+template<typename F, typename F_primitive>
+std::vector<F> logup_multiplicities(const LookupTable<F_primitive>& table, const std::vector<F>& queries)
+{
+    std::unordered_map<std::string, uint32> index;
+    for (uint32 j = 0; j < table.values.size(); j++)
+    {
+        index.emplace(_lookup_key(table.values[j]), j);
+    }
+
+    uint32 nb_lanes = 1;
+    if constexpr (!std::is_same_v<F, F_primitive>)
+    {
+        nb_lanes = F::pack_size();
+    }
+    std::vector<M31_field::M31> counts(table.values.size() * nb_lanes, M31_field::M31::zero());
+    std::vector<F_primitive> lanes = unpack_lanes<F, F_primitive>(queries);
+    for (uint32 i = 0; i < lanes.size(); i++)
+    {
+        auto it = index.find(_lookup_key(lanes[i]));
+        if (it != index.end())
+        {
+            counts[it->second * nb_lanes + i % nb_lanes] += M31_field::M31::one();
+        }
+    }
+
+    std::vector<F> m(table.values.size());
+    if constexpr (std::is_same_v<F, F_primitive>)
+    {
+        for (uint32 j = 0; j < m.size(); j++)
+        {
+            m[j] = F(counts[j]);
+        }
+    }
+    else
+    {
+        std::vector<M31_field::VectorizedM31> packed = M31_field::VectorizedM31::pack_field_elements(counts);
+        for (uint32 j = 0; j < m.size(); j++)
+        {
+            m[j] = F(packed[j]);
+        }
+    }
+    return m;
+}
+
+// The leaves of the fraction tree, see above
+template<typename F, typename F_primitive>
+void _logup_leaves(const LookupTable<F_primitive>& table, const std::vector<F>& m, const std::vector<F>& queries, const F_primitive& alpha,
+    std::vector<F>& p, std::vector<F>& q)
+{
+    uint32 half = std::max(queries.size(), table.values.size());
+    p.assign(2 * half, F::zero());
+    q.assign(2 * half, F::one());
+    for (uint32 i = 0; i < queries.size(); i++)
+    {
+        p[i] = F::one();
+        q[i] = -queries[i] + alpha;
+    }
+    for (uint32 j = 0; j < table.values.size(); j++)
+    {
+        p[half + j] = -m[j];
+        q[half + j] = F::zero() + (alpha - table.values[j]);
+    }
+}
+
+// p(rz) + lambda q(rz) of a level, the sumcheck reading eq, p(0, .), p(1, .), q(0, .), q(1, .)
+template<typename F, typename F_primitive>
+struct LogUpCombine
+{
+    F_primitive lambda;
+
+    F operator()(const F* g) const
+    {
+        return g[0] * (g[1] * g[4] + g[2] * g[3] + g[3] * g[4] * lambda);
+    }
+};
+
+// Proves the lookup of the input layer, the multiplicities are sent first and one tree is proven
+// per repetition. Returns the points of the claims left on the input layer, the claims are appended.
+template<typename F, typename F_primitive>
+std::vector<std::vector<F_primitive>> logup_prove(
+    const LookupTable<F_primitive>& table,
+    const std::vector<F>& queries,
+    Transcript<F, F_primitive>& transcript,
+    const Config& config,
+    ThreadPool* pool = nullptr
+)
+{
+    std::vector<F> m = logup_multiplicities(table, queries);
+    for (const F& m_j: m)
+    {
+        transcript.append_f(m_j);
+    }
+
+    uint32 nb_query_vars = __builtin_ctz(queries.size());
+    uint32 nb_vars = std::max(nb_query_vars, table.nb_vars());
+    std::vector<std::vector<F_primitive>> rq(config.get_num_repetitions());
+    for (int j = 0; j < config.get_num_repetitions(); j++)
+    {
+        F_primitive alpha = transcript.challenge_f();
+
+        // levels[k] has k variables, levels[nb_vars + 1] are the leaves
+        std::vector<std::vector<F>> p_levels(nb_vars + 2), q_levels(nb_vars + 2);
+        _logup_leaves(table, m, queries, alpha, p_levels[nb_vars + 1], q_levels[nb_vars + 1]);
+        for (uint32 k = nb_vars + 1; k > 0; k--)
+        {
+            const std::vector<F>& p = p_levels[k];
+            const std::vector<F>& q = q_levels[k];
+            p_levels[k - 1].resize(p.size() / 2);
+            q_levels[k - 1].resize(q.size() / 2);
+            parallel_for(pool, p.size() / 2, [&](uint32 thread_id, uint32 begin, uint32 end)
+            {
+                for (uint32 i = begin; i < end; i++)
+                {
+                    p_levels[k - 1][i] = p[2 * i] * q[2 * i + 1] + p[2 * i + 1] * q[2 * i];
+                    q_levels[k - 1][i] = q[2 * i] * q[2 * i + 1];
+                }
+            });
+        }
+
+        // the root is checked from the two fractions below it
+        for (const std::vector<F>* level: {&p_levels[1], &q_levels[1]})
+        {
+            transcript.append_f((*level)[0]);
+            transcript.append_f((*level)[1]);
+        }
+        std::vector<F_primitive> r = {transcript.challenge_f()};
+
+        for (uint32 k = 1; k <= nb_vars; k++)
+        {
+            LogUpCombine<F, F_primitive> combine{transcript.challenge_f()};
+            uint32 size = 1 << k;
+            std::vector<F_primitive> eq_r(size);
+            _eq_evals_at_primitive(r, F_primitive::one(), eq_r.data());
+            std::vector<std::vector<F>> g(5, std::vector<F>(size));
+            const std::vector<F>& p = p_levels[k + 1];
+            const std::vector<F>& q = q_levels[k + 1];
+            for (uint32 x = 0; x < size; x++)
+            {
+                g[0][x] = F::zero() + eq_r[x];
+                g[1][x] = p[2 * x];
+                g[2][x] = p[2 * x + 1];
+                g[3][x] = q[2 * x];
+                g[4][x] = q[2 * x + 1];
+            }
+            auto rs = std::get<0>(sumcheck_prove_virtual<F, F_primitive>({g[0].data(), g[1].data(), g[2].data(), g[3].data(), g[4].data()},
+                k, 3, combine, transcript, pool));
+            r = {transcript.challenge_f()};
+            r.insert(r.end(), rs.begin(), rs.end());
+        }
+
+        rq[j].assign(r.begin(), r.begin() + nb_query_vars);
+        transcript.append_f(eval_multilinear(queries, rq[j]));
+    }
+    return rq;
+}
+
+// Checks a proof of logup_prove, returns {verified, rq, vq} where the claims vq at rq are left on the input layer
+template<typename F, typename F_primitive>
+std::tuple<bool, std::vector<std::vector<F_primitive>>, std::vector<F>> logup_verify(
+    const LookupTable<F_primitive>& table,
+    uint32 nb_query_vars,
+    Proof<F>& proof,
+    Transcript<F, F_primitive>& transcript,
+    const Config& config
+)
+{
+    std::vector<F> m(table.values.size());
+    for (F& m_j: m)
+    {
+        m_j = proof.get_next_and_step();
+        transcript.append_f(m_j);
+    }
+
+    uint32 nb_vars = std::max(nb_query_vars, table.nb_vars());
+    bool verified = true;
+    std::vector<std::vector<F_primitive>> rq(config.get_num_repetitions());
+    std::vector<F> vq(config.get_num_repetitions());
+    for (int j = 0; j < config.get_num_repetitions(); j++)
+    {
+        F_primitive alpha = transcript.challenge_f();
+
+        F p_0 = proof.get_next_and_step(), p_1 = proof.get_next_and_step();
+        F q_0 = proof.get_next_and_step(), q_1 = proof.get_next_and_step();
+        for (const F& v: {p_0, p_1, q_0, q_1})
+        {
+            transcript.append_f(v);
+        }
+        // the queries and the table cancel out
+        verified &= p_0 * q_1 + p_1 * q_0 == F::zero();
+        std::vector<F_primitive> r = {transcript.challenge_f()};
+        F claim_p = p_0 + (p_1 - p_0) * r[0];
+        F claim_q = q_0 + (q_1 - q_0) * r[0];
+
+        for (uint32 k = 1; k <= nb_vars; k++)
+        {
+            LogUpCombine<F, F_primitive> combine{transcript.challenge_f()};
+            auto [level_verified, rs, evals] = sumcheck_verify_virtual<F, F_primitive>(k, 5, 3, claim_p + claim_q * combine.lambda, combine, proof, transcript);
+            verified &= level_verified && evals[0] == F::zero() + _eq_at(r, rs);
+            r = {transcript.challenge_f()};
+            r.insert(r.end(), rs.begin(), rs.end());
+            claim_p = evals[1] + (evals[2] - evals[1]) * r[0];
+            claim_q = evals[3] + (evals[4] - evals[3]) * r[0];
+        }
+
+        // the leaves at r from the queries, the table and the multiplicities
+        F_primitive r_table = r[nb_vars];
+        F_primitive query_part = F_primitive::one() - r_table;
+        F_primitive table_part = r_table;
+        for (uint32 i = nb_query_vars; i < nb_vars; i++)
+        {
+            query_part *= F_primitive::one() - r[i];
+        }
+        for (uint32 i = table.nb_vars(); i < nb_vars; i++)
+        {
+            table_part *= F_primitive::one() - r[i];
+        }
+        std::vector<F_primitive> rt(r.begin(), r.begin() + table.nb_vars());
+        rq[j].assign(r.begin(), r.begin() + nb_query_vars);
+        vq[j] = proof.get_next_and_step();
+        transcript.append_f(vq[j]);
+
+        F_primitive t = eval_multilinear(table.values, rt);
+        F m_r = eval_multilinear(m, rt);
+        verified &= claim_p == F::zero() + query_part - m_r * table_part;
+        verified &= claim_q == F::one() + (-vq[j] + (alpha - F_primitive::one())) * query_part + (alpha - F_primitive::one() - t) * table_part;
+    }
+    return {verified, rq, vq};
+}
+
+}
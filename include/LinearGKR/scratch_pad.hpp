@@ -1,6 +1,8 @@
 #pragma once
 
 #include "circuit/circuit.hpp"
+#include "utils/thread_pool.hpp"
+#include "sumcheck_common.hpp"
 
 namespace gkr
 {
@@ -9,7 +11,7 @@ template<typename F, typename F_primitive>
 class GKRScratchPad
 {
 private:
-    void _mem_init(uint32 max_nb_output, uint32 max_nb_input)
+    void _mem_init(uint32 max_nb_input, uint32 max_eq_output, uint32 max_eq_input)
     {
         uint32 F_size = sizeof(F);
 
@@ -24,30 +26,48 @@ private:
         #endif
         v_evals = __allocate(max_nb_input);
         hg_evals = __allocate(max_nb_input);
-        eq_evals_at_rx = __allocate_primitive(max_nb_input);
-        eq_evals_at_rz1 = __allocate_primitive(max_nb_output);
-        eq_evals_at_rz2 = __allocate_primitive(max_nb_output);
-        eq_evals_first_half = __allocate_primitive(max_nb_output);
-        eq_evals_second_half = __allocate_primitive(max_nb_output);
-        gate_exists = (bool*)malloc(max_nb_input * sizeof(bool));
+        eq_evals_at_rx_first_half = __allocate_primitive(max_eq_input);
+        eq_evals_at_rx_second_half = __allocate_primitive(max_eq_input);
+        eq_evals_at_rz1_first_half = __allocate_primitive(max_eq_output);
+        eq_evals_at_rz1_second_half = __allocate_primitive(max_eq_output);
+        eq_evals_at_rz2_first_half = __allocate_primitive(max_eq_output);
+        eq_evals_at_rz2_second_half = __allocate_primitive(max_eq_output);
+        gate_exists = (uint64*)malloc(bitset_nb_words(max_nb_input) * sizeof(uint64));
+
+        // the folds can only run in place on a single thread,
+        // with a pool each round writes into the other half of a double buffer
+        if (pool != nullptr)
+        {
+            v_evals_swap = __allocate(max_nb_input);
+            hg_evals_swap = __allocate(max_nb_input);
+            gate_exists_swap = (uint64*)malloc(bitset_nb_words(max_nb_input) * sizeof(uint64));
+        }
     }
 
 public:
     F *v_evals, *hg_evals;
-    F_primitive *eq_evals_at_rx;
-    F_primitive *eq_evals_at_rz1, *eq_evals_at_rz2;
-    F_primitive *eq_evals_first_half, *eq_evals_second_half;
-    bool *gate_exists;
+    // eq tables are kept as their two sqrt sized halves, see EqSqrtView
+    F_primitive *eq_evals_at_rx_first_half, *eq_evals_at_rx_second_half;
+    F_primitive *eq_evals_at_rz1_first_half, *eq_evals_at_rz1_second_half;
+    F_primitive *eq_evals_at_rz2_first_half, *eq_evals_at_rz2_second_half;
+    // bitset, one bit per input telling whether any gate reads it
+    uint64 *gate_exists;
+
+    // only allocated when a thread pool is attached
+    F *v_evals_swap = nullptr, *hg_evals_swap = nullptr;
+    uint64 *gate_exists_swap = nullptr;
+    ThreadPool *pool = nullptr;
 
-    void prepare(const Circuit<F, F_primitive> &circuit)
+    void prepare(const Circuit<F, F_primitive> &circuit, ThreadPool *pool_ = nullptr)
     {
+        pool = pool_;
         uint32 max_nb_output_vars = 0, max_nb_input_vars = 0;
         for (const CircuitLayer<F, F_primitive> &layer: circuit.layers)
         {
             max_nb_output_vars = std::max(max_nb_output_vars, layer.nb_output_vars);
             max_nb_input_vars = std::max(max_nb_input_vars, layer.nb_input_vars);
         }
-        _mem_init(1 << max_nb_output_vars, 1 << max_nb_input_vars);
+        _mem_init(1 << max_nb_input_vars, eq_sqrt_table_size(max_nb_output_vars), eq_sqrt_table_size(max_nb_input_vars));
     }
 
     ~GKRScratchPad()
@@ -55,12 +75,16 @@ public:
         #define __free(x) free(reinterpret_cast<void*>(x))
         __free(v_evals);
         __free(hg_evals);
-        __free(eq_evals_at_rx);
-        __free(eq_evals_at_rz1);
-        __free(eq_evals_at_rz2);
-        __free(eq_evals_first_half);
-        __free(eq_evals_second_half);
+        __free(eq_evals_at_rx_first_half);
+        __free(eq_evals_at_rx_second_half);
+        __free(eq_evals_at_rz1_first_half);
+        __free(eq_evals_at_rz1_second_half);
+        __free(eq_evals_at_rz2_first_half);
+        __free(eq_evals_at_rz2_second_half);
         free(gate_exists);
+        __free(v_evals_swap);
+        __free(hg_evals_swap);
+        free(gate_exists_swap);
     }
 };
 
@@ -20,6 +20,33 @@ struct SumcheckProof
 };
 
 
+// A degree d round message is sent as p(0), p(2), ..., p(d), the verifier recovers p(1) = claim - p(0)
+template<typename F, typename F_primitive>
+void append_round_message(Transcript<F, F_primitive>& transcript, const std::vector<F>& evals)
+{
+    transcript.append_f(evals[0]);
+    for (uint32 t = 2; t < evals.size(); t++)
+    {
+        transcript.append_f(evals[t]);
+    }
+}
+
+// Reads a message of append_round_message, returns {p(0), ..., p(degree)} given the running claim p(0) + p(1)
+template<typename F, typename F_primitive>
+std::vector<F> read_round_message(Proof<F>& proof, Transcript<F, F_primitive>& transcript, const F& claim, uint32 degree = 2)
+{
+    std::vector<F> evals(degree + 1);
+    evals[0] = proof.get_next_and_step();
+    transcript.append_f(evals[0]);
+    evals[1] = claim - evals[0];
+    for (uint32 t = 2; t <= degree; t++)
+    {
+        evals[t] = proof.get_next_and_step();
+        transcript.append_f(evals[t]);
+    }
+    return evals;
+}
+
 template<typename F, typename F_primitive>
 bool sumcheck_verify_multilinear(
     const MultiLinearPoly<F>& poly,
@@ -32,6 +59,7 @@ bool sumcheck_verify_multilinear(
 
     F sum = claimed_sum;
     bool verified = true;
+    std::vector<F_primitive> rs;
     for (uint32 i_var = 0; i_var < nb_vars; i_var++)
     {
         const std::vector<F>& low_degree_evals = proof.low_degree_poly_evals[i_var];
@@ -40,11 +68,13 @@ bool sumcheck_verify_multilinear(
         transcript.append_f(low_degree_evals[0]);
         transcript.append_f(low_degree_evals[1]);
         auto r = transcript.challenge_f();
+        rs.emplace_back(r);
 
         verified &= (low_degree_evals[0] + low_degree_evals[1]) == sum;
         sum = low_degree_evals[0] + (low_degree_evals[1] - low_degree_evals[0]) * r;
     }
-    // TODO: CHECK FINAL EVALUATION
+    // the poly is known to the verifier, so the final claim is checked directly
+    verified &= sum == eval_multilinear(poly.evals, rs);
 
     return verified;
 }
@@ -62,27 +92,53 @@ std::tuple<std::vector<std::vector<F_primitive>>, std::vector<std::vector<F_prim
     const Config &config
 )
 {
-    SumcheckGKRHelper<F, F_primitive> helper[3]; // TODO remove this constant
+    uint32 nb_repetitions = config.get_num_repetitions();
+    std::vector<SumcheckGKRHelper<F, F_primitive>> helper(nb_repetitions);
     timer.add_timing("    prepare time");
-    for (uint32 i = 0; i < config.get_num_repetitions(); i++)
-    {
-        helper[i].prepare(poly, rz1[i], rz2[i], alpha, beta, scratch_pad[i], timer);
-    }
+    SumcheckGKRHelper<F, F_primitive>::prepare_repetitions(helper.data(), nb_repetitions, poly, rz1.data(), rz2.data(), alpha, beta, scratch_pad, timer);
     timer.report_timing("    prepare time");
-    for (uint32 i_var = 0; i_var < (2 * poly.nb_input_vars); i_var++)
+    // a linear layer has g(x) = add(rz, x) only, so phase one alone reduces it to the single claim v(rx)
+    bool linear = poly.is_linear();
+    uint32 nb_rounds = linear ? poly.nb_input_vars : 2 * poly.nb_input_vars;
+    for (uint32 i_var = 0; i_var < nb_rounds; i_var++)
     {
-        for(int j = 0; j < config.get_num_repetitions(); j++)
+        if (i_var == poly.nb_input_vars)
+        {
+            SumcheckGKRHelper<F, F_primitive>::prepare_phase_two_repetitions(helper.data(), nb_repetitions, timer);
+        }
+
+        // the first round of each phase is evaluated and folded for all repetitions in one pass,
+        // except for folds that have to happen before a vx claim enters the transcript
+        // and phase one of layers with power gates, whose rounds have a higher degree
+        bool phase_one = i_var < poly.nb_input_vars;
+        uint32 degree = phase_one ? poly.phase_one_degree() : 2;
+        bool round_zero = SumcheckGKRHelper<F, F_primitive>::is_round_zero(i_var, poly.nb_input_vars) && !(phase_one && poly.has_pow());
+        bool fused_fold = round_zero && i_var != poly.nb_input_vars - 1;
+        std::vector<std::vector<F>> round_zero_evals;
+        std::vector<F_primitive> rs;
+        if (round_zero)
         {
             timer.add_timing("    eval poly " + std::to_string(i_var) + " time");
-            std::vector<F> evals = helper[j].poly_evals_at(i_var, 2, timer);
+            round_zero_evals = SumcheckGKRHelper<F, F_primitive>::poly_evals_at_round_zero(helper.data(), nb_repetitions, i_var, degree);
+            timer.report_timing("    eval poly " + std::to_string(i_var) + " time");
+        }
+
+        for(uint32 j = 0; j < nb_repetitions; j++)
+        {
+            timer.add_timing("    eval poly " + std::to_string(i_var) + " time");
+            std::vector<F> evals = round_zero ? round_zero_evals[j] : helper[j].poly_evals_at(i_var, degree, timer);
             timer.report_timing("    eval poly " + std::to_string(i_var) + " time");
             timer.add_timing("    append evals " + std::to_string(i_var) + " time");
-            transcript.append_f(evals[0]);
-            transcript.append_f(evals[1]);
-            transcript.append_f(evals[2]);
+            append_round_message(transcript, evals);
             auto r = transcript.challenge_f();
             timer.report_timing("    append evals " + std::to_string(i_var) + " time");
 
+            if (fused_fold)
+            {
+                rs.emplace_back(r);
+                continue;
+            }
+
             timer.add_timing("    receive challenge " + std::to_string(i_var) + " time");
             helper[j].receive_challenge(i_var, r);
             timer.report_timing("    receive challenge " + std::to_string(i_var) + " time");
@@ -94,14 +150,32 @@ std::tuple<std::vector<std::vector<F_primitive>>, std::vector<std::vector<F_prim
                 timer.report_timing("    vx_claim time");
             }
         }
+
+        if (fused_fold)
+        {
+            timer.add_timing("    receive challenge " + std::to_string(i_var) + " time");
+            SumcheckGKRHelper<F, F_primitive>::receive_challenge_round_zero(helper.data(), nb_repetitions, i_var, rs);
+            timer.report_timing("    receive challenge " + std::to_string(i_var) + " time");
+        }
+    }
+    std::vector<std::vector<F_primitive>> rz1s, rz2s;
+    if (linear)
+    {
+        // the next layer proves alpha v(rx) + beta v(rx)
+        for(int j = 0; j < config.get_num_repetitions(); j++)
+        {
+            rz1s.emplace_back(helper[j].rx);
+            rz2s.emplace_back(helper[j].rx);
+        }
+        return {rz1s, rz2s};
     }
+
     for(int j = 0; j < config.get_num_repetitions(); j++)
     {
         timer.add_timing("  vy_claim time");
         transcript.append_f(helper[j].vy_claim());
         timer.report_timing("  vy_claim time");
     }
-    std::vector<std::vector<F_primitive>> rz1s, rz2s;
     for(int j = 0; j < config.get_num_repetitions(); j++)
     {
         rz1s.emplace_back(helper[j].rx);
@@ -110,6 +184,142 @@ std::tuple<std::vector<std::vector<F_primitive>>, std::vector<std::vector<F_prim
     return {rz1s, rz2s};
 }
 
+// Reduces the two claims v(rz1), v(rz2) left on the input layer to a single claim v(r), so the input
+// is opened once per repetition:
+//  v(rz1) + a v(rz2) = \sum_x v(x) (eq(rz1, x) + a eq(rz2, x))
+// with a drawn once both claims are fixed. This is phase one of a layer sumcheck whose g(x) is the eq sum,
+// the claim v(r) is appended after the last round. The claims v(rq) of a lookup, when there are any,
+// join the sum as a^2 v(rq).
+template<typename F, typename F_primitive>
+std::vector<std::vector<F_primitive>> sumcheck_prove_combine_claims(
+    const CircuitLayer<F, F_primitive>& input_layer,
+    const std::vector<std::vector<F_primitive>>& rz1,
+    const std::vector<std::vector<F_primitive>>& rz2,
+    Transcript<F, F_primitive>& transcript,
+    GKRScratchPad<F, F_primitive> *scratch_pad,
+    const Config &config,
+    const std::vector<std::vector<F_primitive>>& rq = {}
+)
+{
+    uint32 nb_repetitions = config.get_num_repetitions();
+    uint32 nb_vars = input_layer.nb_input_vars;
+    uint32 size = 1 << nb_vars;
+    const witness_field_t<F>* v = input_layer.input_layer_vals.evals.data();
+    std::vector<SumcheckMultiLinearProdHelper<F, F_primitive>> helper(nb_repetitions);
+    for (uint32 j = 0; j < nb_repetitions; j++)
+    {
+        GKRScratchPad<F, F_primitive>& pad = scratch_pad[j];
+        F_primitive a = transcript.challenge_f();
+        uint32 table_size = eq_sqrt_table_size(nb_vars);
+        std::vector<F_primitive> eq_halves(6 * table_size);
+        EqSqrtView<F_primitive> eq_rz1 = _eq_evals_sqrt_at(rz1[j], F_primitive::one(), eq_halves.data(), eq_halves.data() + table_size);
+        EqSqrtView<F_primitive> eq_rz2 = _eq_evals_sqrt_at(rz2[j], a, eq_halves.data() + 2 * table_size, eq_halves.data() + 3 * table_size);
+        bool with_rq = !rq.empty();
+        EqSqrtView<F_primitive> eq_rq;
+        if (with_rq)
+        {
+            eq_rq = _eq_evals_sqrt_at(rq[j], a * a, eq_halves.data() + 4 * table_size, eq_halves.data() + 5 * table_size);
+        }
+        parallel_for(pad.pool, size, [&](uint32 thread_id, uint32 begin, uint32 end)
+        {
+            for (uint32 x = begin; x < end; x++)
+            {
+                F_primitive eq_sum = eq_rz1[x] + eq_rz2[x];
+                if (with_rq)
+                {
+                    eq_sum += eq_rq[x];
+                }
+                pad.hg_evals[x] = F::zero() + eq_sum;
+            }
+        });
+        // every entry has a "gate"
+        memset(pad.gate_exists, 0xFF, sizeof(uint64) * bitset_nb_words(size));
+        if (size < 64)
+        {
+            pad.gate_exists[0] = (1ULL << size) - 1;
+        }
+
+        helper[j].prepare(nb_vars, pad.v_evals, pad.hg_evals, v, pad.gate_exists, pad.pool, pad.v_evals_swap, pad.hg_evals_swap, pad.gate_exists_swap);
+        helper[j].initial_v_is_bits = input_layer.input_is_bits;
+        helper[j].set_active_size(input_layer.nb_active_inputs);
+    }
+
+    std::vector<std::vector<F_primitive>> rs(nb_repetitions);
+    for (uint32 i_var = 0; i_var < nb_vars; i_var++)
+    {
+        for (uint32 j = 0; j < nb_repetitions; j++)
+        {
+            std::vector<F> evals = helper[j].poly_eval_at(i_var, 2);
+            append_round_message(transcript, evals);
+            auto r = transcript.challenge_f();
+            helper[j].receive_challenge(i_var, r);
+            rs[j].emplace_back(r);
+        }
+    }
+    for (uint32 j = 0; j < nb_repetitions; j++)
+    {
+        transcript.append_f(nb_vars == 0 ? F(v[0]) : helper[j].bookkeeping_f[0]);
+    }
+    return rs;
+}
+
+// Checks the sumcheck of sumcheck_prove_combine_claims, returns {verified, r, v(r)} where v(r) is left to the opening
+template<typename F, typename F_primitive>
+std::tuple<bool, std::vector<std::vector<F_primitive>>, std::vector<F>> sumcheck_verify_combine_claims(
+    const CircuitLayer<F, F_primitive>& input_layer,
+    const std::vector<std::vector<F_primitive>>& rz1,
+    const std::vector<std::vector<F_primitive>>& rz2,
+    const std::vector<F>& claimed_v1,
+    const std::vector<F>& claimed_v2,
+    Proof<F>& proof,
+    Transcript<F, F_primitive>& transcript,
+    const Config &config,
+    const std::vector<std::vector<F_primitive>>& rq = {},
+    const std::vector<F>& claimed_vq = {}
+)
+{
+    uint32 nb_repetitions = config.get_num_repetitions();
+    std::vector<F_primitive> a(nb_repetitions);
+    std::vector<F> sum(nb_repetitions);
+    for (uint32 j = 0; j < nb_repetitions; j++)
+    {
+        a[j] = transcript.challenge_f();
+        sum[j] = claimed_v1[j] + claimed_v2[j] * a[j];
+        if (!rq.empty())
+        {
+            sum[j] += claimed_vq[j] * (a[j] * a[j]);
+        }
+    }
+
+    bool verified = true;
+    std::vector<std::vector<F_primitive>> rs(nb_repetitions);
+    for (uint32 i_var = 0; i_var < input_layer.nb_input_vars; i_var++)
+    {
+        for (uint32 j = 0; j < nb_repetitions; j++)
+        {
+            const std::vector<F> low_degree_evals = read_round_message(proof, transcript, sum[j]);
+            auto r = transcript.challenge_f();
+
+            rs[j].emplace_back(r);
+            sum[j] = degree_2_eval(low_degree_evals, r);
+        }
+    }
+
+    std::vector<F> v_claim(nb_repetitions);
+    for (uint32 j = 0; j < nb_repetitions; j++)
+    {
+        v_claim[j] = proof.get_next_and_step();
+        F_primitive eq_sum = _eq_at(rz1[j], rs[j]) + a[j] * _eq_at(rz2[j], rs[j]);
+        if (!rq.empty())
+        {
+            eq_sum += a[j] * a[j] * _eq_at(rq[j], rs[j]);
+        }
+        verified &= sum[j] == v_claim[j] * eq_sum;
+        transcript.append_f(v_claim[j]);
+    }
+    return {verified, rs, v_claim};
+}
+
 template<typename F, typename F_primitive>
 std::tuple<bool, std::vector<std::vector<F_primitive>>, std::vector<std::vector<F_primitive>>, std::vector<F>, std::vector<F> > sumcheck_verify_gkr_layer(
     const CircuitLayer<F, F_primitive>& poly,
@@ -129,6 +339,11 @@ std::tuple<bool, std::vector<std::vector<F_primitive>>, std::vector<std::vector<
     for(int i = 0; i < config.get_num_repetitions(); i++)
     { 
         sum.push_back(claimed_v1[i] * alpha + claimed_v2[i] * beta);
+        // the constants are not summed over by the prover, their part of the claim is known
+        if (!poly.cst.empty())
+        {
+            sum.back() = sum.back() + -eval_sparse_const_poly(poly.cst, rz1[i], rz2[i], alpha, beta);
+        }
     }
     std::vector<std::vector<F_primitive>> rx, ry;
     rx.resize(config.get_num_repetitions());
@@ -137,25 +352,27 @@ std::tuple<bool, std::vector<std::vector<F_primitive>>, std::vector<std::vector<
     std::vector<F> vx_claim;
     vx_claim.resize(config.get_num_repetitions());
     bool verified = true;
-    for (uint32 i_var = 0; i_var < (2 * nb_vars); i_var++)
+    // the prover runs phase one only for layers without mul gates, see sumcheck_prove_gkr_layer
+    bool linear = poly.is_linear();
+    uint32 nb_rounds = linear ? nb_vars : 2 * nb_vars;
+    for (uint32 i_var = 0; i_var < nb_rounds; i_var++)
     {
         for(int j = 0; j < config.get_num_repetitions(); j++)
         {
-            const std::vector<F> low_degree_evals = {proof.get_next_and_step(), proof.get_next_and_step(), proof.get_next_and_step()};
-
-            transcript.append_f(low_degree_evals[0]);
-            transcript.append_f(low_degree_evals[1]);
-            transcript.append_f(low_degree_evals[2]);
+            const std::vector<F> low_degree_evals = read_round_message(proof, transcript, sum[j], i_var < nb_vars ? poly.phase_one_degree() : 2);
             auto r = transcript.challenge_f();
 
             (*rs)[j].emplace_back(r);
-            verified &= (low_degree_evals[0] + low_degree_evals[1]) == sum[j];
-            sum[j] = degree_2_eval(low_degree_evals, r);
+            sum[j] = eval_from_evals(low_degree_evals, r);
 
             if (i_var == nb_vars - 1)
             {
                 vx_claim[j] = proof.get_next_and_step();
                 sum[j] -= vx_claim[j] * eval_sparse_circuit_connect_poly<F, F_primitive, 1>(poly.add, rz1[j], rz2[j], alpha, beta, {rx[j]});
+                if (poly.has_pow())
+                {
+                    sum[j] -= pow_small(vx_claim[j], poly.pow_degree) * eval_sparse_circuit_connect_poly<F, F_primitive, 1>(poly.pow, rz1[j], rz2[j], alpha, beta, {rx[j]});
+                }
                 transcript.append_f(vx_claim[j]);
             }
         }
@@ -164,6 +381,16 @@ std::tuple<bool, std::vector<std::vector<F_primitive>>, std::vector<std::vector<
             rs = &ry;
         }
     }
+    if (linear)
+    {
+        // what is left of the sum after the add part is the mul part, which is zero
+        for(int j = 0; j < config.get_num_repetitions(); j++)
+        {
+            verified &= sum[j] == F::zero();
+        }
+        return {verified, rx, rx, vx_claim, vx_claim};
+    }
+
     std::vector<F> vy_claim;
     for(int j = 0; j < config.get_num_repetitions(); j++)
     {
@@ -2,6 +2,7 @@
 
 #include <vector>
 #include "circuit/circuit.hpp"
+#include "utils/thread_pool.hpp"
 
 namespace gkr
 {
@@ -13,6 +14,19 @@ inline F_primitive _eq(const F_primitive& x, const F_primitive& y)
     return x * y * 2 - x - y + 1;
 }
 
+// eq(x, y) of two points
+template<typename F_primitive>
+F_primitive _eq_at(const std::vector<F_primitive>& x, const std::vector<F_primitive>& y)
+{
+    assert(x.size() == y.size());
+    F_primitive v = F_primitive::one();
+    for (uint32 i = 0; i < x.size(); i++)
+    {
+        v *= _eq(x[i], y[i]);
+    }
+    return v;
+}
+
 template<typename F_primitive>
 void _eq_evals_at_primitive(const std::vector<F_primitive>& r, const F_primitive& mul_factor, F_primitive* eq_evals)
 {
@@ -37,19 +51,54 @@ void _eq_evals_at_primitive(const std::vector<F_primitive>& r, const F_primitive
 // the bits are interpreted as little endian numbers
 // The returned value is multiplied by the 'mul_factor' argument
 template<typename F_primitive>
-void _eq_evals_at(const std::vector<F_primitive>& r, const F_primitive& mul_factor, F_primitive* eq_evals, F_primitive* sqrtN1st, F_primitive* sqrtN2nd)
+void _eq_evals_at(const std::vector<F_primitive>& r, const F_primitive& mul_factor, F_primitive* eq_evals, F_primitive* sqrtN1st, F_primitive* sqrtN2nd, ThreadPool *pool = nullptr)
 {
     auto first_half_bits = r.size() / 2;
     auto first_half_mask = (1 << first_half_bits) - 1;
     _eq_evals_at_primitive(std::vector<F_primitive>(r.begin(), r.begin() + first_half_bits), mul_factor, sqrtN1st);
     _eq_evals_at_primitive(std::vector<F_primitive>(r.begin() + first_half_bits, r.end()), F_primitive(1), sqrtN2nd);
 
-    for (uint32 i = 0; i < (uint32)(1 << r.size()); i++)
+    parallel_for(pool, 1 << r.size(), [&](uint32 thread_id, uint32 begin, uint32 end)
+    {
+        for (uint32 i = begin; i < end; i++)
+        {
+            uint32 first_half = i & first_half_mask;
+            uint32 second_half = i >> first_half_bits;
+            eq_evals[i] = sqrtN1st[first_half] * sqrtN2nd[second_half];
+        }
+    });
+}
+
+// eq(r, z) read from the two sqrt sized tables of the halves of r, first[z & first_mask] * second[z >> first_bits],
+// so the gate loops never need the 2^n table
+template<typename F_primitive>
+class EqSqrtView
+{
+public:
+    const F_primitive *first, *second;
+    uint32 first_bits;
+    uint32 first_mask;
+
+    inline F_primitive operator[](uint32 z) const
     {
-        uint32 first_half = i & first_half_mask;
-        uint32 second_half = i >> first_half_bits;
-        eq_evals[i] = sqrtN1st[first_half] * sqrtN2nd[second_half];
+        return first[z & first_mask] * second[z >> first_bits];
     }
+};
+
+// Size of each of the two tables of an EqSqrtView over nb_vars variables
+inline uint32 eq_sqrt_table_size(uint32 nb_vars)
+{
+    return 1 << (nb_vars - nb_vars / 2);
+}
+
+// Fills the halves of eq(r, .) multiplied by 'mul_factor', see _eq_evals_at
+template<typename F_primitive>
+EqSqrtView<F_primitive> _eq_evals_sqrt_at(const std::vector<F_primitive>& r, const F_primitive& mul_factor, F_primitive* sqrtN1st, F_primitive* sqrtN2nd)
+{
+    uint32 first_half_bits = r.size() / 2;
+    _eq_evals_at_primitive(std::vector<F_primitive>(r.begin(), r.begin() + first_half_bits), mul_factor, sqrtN1st);
+    _eq_evals_at_primitive(std::vector<F_primitive>(r.begin() + first_half_bits, r.end()), F_primitive(1), sqrtN2nd);
+    return EqSqrtView<F_primitive>{sqrtN1st, sqrtN2nd, first_half_bits, (1u << first_half_bits) - 1};
 }
 
 } // namespace LinearGKR
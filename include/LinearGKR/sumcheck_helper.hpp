@@ -5,6 +5,9 @@
 #include "utils/myutil.hpp"
 #include "sumcheck_common.hpp"
 #include "scratch_pad.hpp"
+#include "gate_kernels.hpp"
+#include "hypercube_kernels.hpp"
+#include "sumcheck_verifier_utils.hpp"
 #include "field/M31.hpp"
 #include <cstring>
 #ifdef __ARM_NEON
@@ -44,18 +47,62 @@ class Timing
         cout << name << " took " << duration.count() << " microseconds" << endl;
     }
 };
+// bit 2j of the result is set iff pair j of the word, i.e. bits 2j and 2j + 1, has a gate
+inline uint64 _nonempty_pairs(uint64 w)
+{
+    return (w | (w >> 1)) & 0x5555555555555555ULL;
+}
+
+// hg is kept as an (index, value) list while less than one entry in this many has a gate
+const uint32 SPARSE_DENSITY_RATIO = 16;
+
 template<typename F, typename F_primitive>
 class SumcheckMultiLinearProdHelper
 {
 public:
+    using W = witness_field_t<F>;
 
     uint32 nb_vars;
     uint32 sumcheck_var_idx;
     uint32 cur_eval_size;
     F* bookkeeping_f;
     F* bookkeeping_hg;
-    const F* initial_v;
-    void prepare(uint32 nb_vars_, F* p1_evals, F* p2_evals, const F* v)
+    // the values of f before any fold, in the witness field. The first fold moves them to F
+    const W* initial_v;
+    // bitset over the cur_eval_size entries, bookkeeping_hg is zero outside of it
+    // and the entries there are never read, so the folds leave them stale
+    uint64* gate_exists;
+
+    // With a thread pool the folds write into the second half of a double buffer
+    // and swap afterwards, the pointers are null when folding in place
+    ThreadPool* pool;
+    F* bookkeeping_f_swap;
+    F* bookkeeping_hg_swap;
+    uint64* gate_exists_swap;
+
+    // The folds also evaluate the next round while the folded values are still in cache,
+    // poly_eval_at then only returns them
+    bool next_evals_ready;
+    F next_evals[3];
+
+    // Every lane of initial_v is 0 or 1, e.g. a boolean witness. Round zero, the only one reading
+    // initial_v, then multiplies by it with selects. Set after prepare, which clears it.
+    bool initial_v_is_bits;
+
+    // f is zero from active_size on, e.g. the padding of a layer whose size is not a power of two.
+    // Only the pairs below _active_end() can contribute, so the loops stop there and ignore any
+    // gate bits past it. Set after prepare, which sets it to the full table.
+    uint32 active_size;
+
+    // Sparse mode: hg is the sorted list (sparse_ids, sparse_hg) instead of bookkeeping_hg and
+    // gate_exists. The list is folded round by round and scattered back into the dense table
+    // once it gets denser than 1 / SPARSE_DENSITY_RATIO. f stays dense, its claim reads every entry.
+    bool sparse;
+    std::vector<uint32> sparse_ids;
+    std::vector<F> sparse_hg;
+
+    void prepare(uint32 nb_vars_, F* p1_evals, F* p2_evals, const W* v, uint64* gate_exists_,
+        ThreadPool* pool_ = nullptr, F* p1_swap = nullptr, F* p2_swap = nullptr, uint64* gate_exists_swap_ = nullptr)
     {
         nb_vars = nb_vars_;
         sumcheck_var_idx = 0;
@@ -63,77 +110,762 @@ public:
         bookkeeping_f = p1_evals;
         bookkeeping_hg = p2_evals;
         initial_v = v;
+        gate_exists = gate_exists_;
+        pool = pool_;
+        bookkeeping_f_swap = p1_swap;
+        bookkeeping_hg_swap = p2_swap;
+        gate_exists_swap = gate_exists_swap_;
+        next_evals_ready = false;
+        initial_v_is_bits = false;
+        sparse = false;
+        active_size = cur_eval_size;
+    }
+
+    void set_active_size(uint32 size)
+    {
+        active_size = std::max(1u, std::min(size, cur_eval_size));
+    }
+
+    // f(src_v) with the table f is read from at round var_idx, initial_v at round zero and
+    // bookkeeping_f afterwards. f is instantiated for both, they differ when W is a subfield of F
+    template<typename Kernel>
+    auto _with_src_v(uint32 var_idx, Kernel&& f) const
+    {
+        if (var_idx == 0)
+        {
+            return f(initial_v);
+        }
+        return f(static_cast<const F*>(bookkeeping_f));
+    }
+
+    // Entries covering the pairs that hold an active entry
+    uint32 _active_end() const
+    {
+        return std::min(cur_eval_size, (active_size + 1) & ~1u);
+    }
+
+    // Word w of a bitset without the bits from end on
+    static inline uint64 _word_below(const uint64* words, uint32 w, uint32 end)
+    {
+        uint32 nb_bits = end - std::min(end, w * 64);
+        return nb_bits >= 64 ? words[w] : words[w] & ((1ULL << nb_bits) - 1);
+    }
+
+    // Folds f over the pairs [begin, end) of dst, reading f(0), f(1) from src
+    template<bool f_is_bits, typename V>
+    static inline void _fold_f_range(const V* src_v, F* dst_f, uint32 begin, uint32 end, const F_primitive& r, const F_primitive& one_minus_r)
+    {
+#ifdef GKR_HYPERCUBE_SIMD
+        if constexpr (std::is_same_v<F, M31_field::M31>)
+        {
+            begin = hypercube::fold_range(src_v, dst_f, begin, end, r);
+        }
+#endif
+        for (uint32 i = begin; i < end; i++)
+        {
+            dst_f[i] = _fold_f<f_is_bits>(src_v[2 * i], src_v[2 * i + 1], r, one_minus_r);
+        }
+    }
+
+    // After folding the entries below dst_active, the entry past them becomes the zero
+    // partner of the last active pair of the next round
+    static inline void _pad_f(F* dst_f, uint32 dst_active, uint32 dst_size)
+    {
+        if ((dst_active & 1) && dst_active < dst_size)
+        {
+            dst_f[dst_active] = F::zero();
+        }
+    }
+
+    static bool use_sparse(uint32 nb_entries, uint32 eval_size)
+    {
+        return static_cast<uint64>(nb_entries) * SPARSE_DENSITY_RATIO < eval_size;
+    }
+
+    // Enters sparse mode after prepare, hg is read from bookkeeping_hg at the sorted ids
+    void prepare_sparse(const std::vector<uint32>& ids)
+    {
+        sparse = true;
+        sparse_ids.assign(ids.begin(), std::lower_bound(ids.begin(), ids.end(), _active_end()));
+        sparse_hg.resize(sparse_ids.size());
+        for (uint32 e = 0; e < sparse_ids.size(); e++)
+        {
+            sparse_hg[e] = bookkeeping_hg[sparse_ids[e]];
+        }
+    }
+
+    // acc += f * hg, where f_is_bits tells that every lane of f is 0 or 1.
+    // An f of the witness field multiplies hg coordinate by coordinate
+    template<bool f_is_bits, typename V, typename G>
+    static inline void _mul_add_f(Accumulator<F>& acc, const V& f, const G& hg)
+    {
+        if constexpr (f_is_bits)
+        {
+            acc.add(mul_by_bit(f, hg));
+        }
+        else if constexpr (std::is_same_v<V, F>)
+        {
+            acc.mul_add(f, hg);
+        }
+        else
+        {
+            acc.add(f * hg);
+        }
+    }
+
+    // f(0) + (f(1) - f(0)) r, given 1 - r as well
+    template<bool f_is_bits, typename V>
+    static inline F _fold_f(const V& f_v_0, const V& f_v_1, const F_primitive& r, const F_primitive& one_minus_r)
+    {
+        if constexpr (f_is_bits)
+        {
+            return mul_by_bit(f_v_0, one_minus_r) + mul_by_bit(f_v_1, r);
+        }
+        else
+        {
+            return f_v_0 + (f_v_1 - f_v_0) * r;
+        }
+    }
+
+    // p0 += f(0) hg(0), p1 += f(1) hg(1), p2 += (f(0) + f(1)) (hg(0) + hg(1)) for a pair whose
+    // gate bits are pair_bits, the hg entry of a missing bit counts as zero.
+    // With f_is_bits, f(0) + f(1) may be 2 so p2 selects both halves separately.
+    template<bool f_is_bits = false, typename V>
+    static inline void _accumulate_pair(uint32 pair_bits, const V& f_v_0, const V& f_v_1, const F* hg, Accumulator<F>& p0, Accumulator<F>& p1, Accumulator<F>& p2)
+    {
+        F hg_sum = pair_bits == 3 ? hg[0] + hg[1] : hg[pair_bits >> 1];
+        if (pair_bits & 1)
+        {
+            _mul_add_f<f_is_bits>(p0, f_v_0, hg[0]);
+        }
+        if (pair_bits & 2)
+        {
+            _mul_add_f<f_is_bits>(p1, f_v_1, hg[1]);
+        }
+        if constexpr (f_is_bits)
+        {
+            p2.add(mul_by_bit(f_v_0, hg_sum));
+            p2.add(mul_by_bit(f_v_1, hg_sum));
+        }
+        else
+        {
+            _mul_add_f<false>(p2, f_v_0 + f_v_1, hg_sum);
+        }
+    }
+
+    // hg(0) + (hg(1) - hg(0)) r for a pair whose gate bits are pair_bits, see _accumulate_pair
+    static inline F _fold_pair(uint32 pair_bits, const F* hg, const F_primitive& r)
+    {
+        if (pair_bits == 3)
+        {
+            return hg[0] + (hg[1] - hg[0]) * r;
+        }
+        else if (pair_bits == 1)
+        {
+            return hg[0] - hg[0] * r;
+        }
+        else
+        {
+            return hg[1] * r;
+        }
+    }
+
+    // Folds the pairs with a gate of one bitset word of hg, src_hg points at the first entry of the word
+    // and dst_hg at its first pair
+    static inline void _fold_hg_word(uint64 word, const F* src_hg, F* dst_hg, const F_primitive& r)
+    {
+#ifdef GKR_HYPERCUBE_SIMD
+        if constexpr (std::is_same_v<F, M31_field::M31>)
+        {
+            hypercube::fold_word(word, src_hg, dst_hg, r);
+            return;
+        }
+#endif
+        for (uint64 pairs = _nonempty_pairs(word); pairs != 0; pairs &= pairs - 1)
+        {
+            uint32 b = __builtin_ctzll(pairs);
+            dst_hg[b / 2] = _fold_pair((word >> b) & 3, src_hg + b, r);
+        }
+    }
+
+    static uint32 _nb_words(uint32 eval_size)
+    {
+        return bitset_nb_words(eval_size);
+    }
+
+    // Next round sums over the pairs of one bitset word of f and hg, i.e. entries [w * 64, w * 64 + 64)
+    template<bool f_is_bits = false, typename V>
+    static inline void _accumulate_word(uint32 w, uint64 word, const V* f, const F* hg, Accumulator<F>& p0, Accumulator<F>& p1, Accumulator<F>& p2)
+    {
+#ifdef GKR_HYPERCUBE_SIMD
+        if constexpr (std::is_same_v<F, M31_field::M31>)
+        {
+            // multiplying by a 0/1 f is exact, the packed kernel serves both
+            hypercube::accumulate_word(w, word, f, hg, p0, p1, p2);
+            return;
+        }
+#endif
+        for (uint64 pairs = _nonempty_pairs(word); pairs != 0; pairs &= pairs - 1)
+        {
+            uint32 b = __builtin_ctzll(pairs);
+            uint32 i = w * 64 + b;
+            _accumulate_pair<f_is_bits>((word >> b) & 3, f[i], f[i + 1], hg + i, p0, p1, p2);
+        }
+    }
+
+    // {p0, p1, p2} from the sums computed over the pairs, p2 is turned into the evaluation at 2
+    static std::vector<F> _finalize_evals(const F& p0, const F& p1, const F& p2)
+    {
+        return {p0, p1, p1 * F(6) + p0 * F(3) - p2 * F(2)};
     }
 
-    std::vector<F> poly_eval_at(uint32 var_idx, uint32 degree, bool *gate_exists)
+    // The pair of list entries starting at e, i.e. those with index sparse_ids[e] >> 1 after the fold.
+    // Fills pair_bits and hg as for _accumulate_pair and returns the entry following the pair.
+    uint32 _sparse_pair(uint32 e, uint32& pair_bits, F* hg) const
+    {
+        uint32 i = sparse_ids[e] >> 1;
+        pair_bits = 0;
+        if ((sparse_ids[e] & 1) == 0)
+        {
+            hg[0] = sparse_hg[e++];
+            pair_bits |= 1;
+        }
+        if (e < sparse_ids.size() && (sparse_ids[e] >> 1) == i)
+        {
+            hg[1] = sparse_hg[e++];
+            pair_bits |= 2;
+        }
+        return e;
+    }
+
+    // Sums the per worker partials (p0, p1, p2) in worker order
+    static std::vector<F> _finalize_partial_sums(const std::vector<F>& partial_sums)
     {
         F p0 = F::zero();
         F p1 = F::zero();
         F p2 = F::zero();
-        auto src_v = (var_idx == 0 ? initial_v : bookkeeping_f);
-        int evalSize = 1 << (nb_vars - var_idx - 1);
+        for (uint32 i = 0; i < partial_sums.size(); i += 3)
+        {
+            p0 += partial_sums[i];
+            p1 += partial_sums[i + 1];
+            p2 += partial_sums[i + 2];
+        }
+        return _finalize_evals(p0, p1, p2);
+    }
+
+    std::vector<F> _poly_eval_at_sparse(uint32 var_idx)
+    {
+        bool f_is_bits = var_idx == 0 && initial_v_is_bits;
 
-        for (int i = 0; i < evalSize; i++)
+        std::vector<F> partial_sums(3 * nb_workers(pool), F::zero());
+        _with_src_v(var_idx, [&](auto src_v)
         {
-            if (!gate_exists[i * 2] && !gate_exists[i * 2 + 1])
+            parallel_for(pool, sparse_ids.size(), [&](uint32 thread_id, uint32 begin, uint32 end)
             {
-                continue;
-            }
-            for(int j = 0; j < gkr::M31_field::vectorize_size; j++)
-            {
-                auto f_v_0 = src_v[i * 2].elements[j];
-                auto f_v_1 = src_v[i * 2 + 1].elements[j];
-                auto hg_v_0 = bookkeeping_hg[i * 2].elements[j];
-                auto hg_v_1 = bookkeeping_hg[i * 2 + 1].elements[j];
-                /*
-                 * Following intrinsics is the same as:
-                p0.elements[j] += f_v_0 * hg_v_0;
-                p1.elements[j] += f_v_1 * hg_v_1;
-                p2.elements[j] += (f_v_0 + f_v_1) * (hg_v_0 + hg_v_1);
-                 */
-            
-                p0.elements[j] += f_v_0 * hg_v_0;
-                p1.elements[j] += f_v_1 * hg_v_1;
-                p2.elements[j] += (f_v_0 + f_v_1) * (hg_v_0 + hg_v_1);
+                Accumulator<F> p0, p1, p2;
+                // a pair belongs to the worker holding its first entry
+                uint32 e = begin;
+                if (e > 0 && e < end && (sparse_ids[e - 1] >> 1) == (sparse_ids[e] >> 1))
+                {
+                    e++;
+                }
+                while (e < end)
+                {
+                    uint32 i = sparse_ids[e] & ~1u;
+                    uint32 pair_bits;
+                    F hg[2];
+                    e = _sparse_pair(e, pair_bits, hg);
+                    if (f_is_bits)
+                    {
+                        _accumulate_pair<true>(pair_bits, src_v[i], src_v[i + 1], hg, p0, p1, p2);
+                    }
+                    else
+                    {
+                        _accumulate_pair(pair_bits, src_v[i], src_v[i + 1], hg, p0, p1, p2);
+                    }
+                }
+                partial_sums[thread_id * 3] = p0.result();
+                partial_sums[thread_id * 3 + 1] = p1.result();
+                partial_sums[thread_id * 3 + 2] = p2.result();
+            });
+        });
+        return _finalize_partial_sums(partial_sums);
+    }
+
+    // Scatters the list into bookkeeping_hg and gate_exists and leaves sparse mode
+    void _densify()
+    {
+        memset(gate_exists, 0, sizeof(uint64) * _nb_words(cur_eval_size));
+        for (uint32 e = 0; e < sparse_ids.size(); e++)
+        {
+            bitset_set(gate_exists, sparse_ids[e]);
+            bookkeeping_hg[sparse_ids[e]] = sparse_hg[e];
+        }
+        sparse = false;
+        sparse_ids.clear();
+        sparse_hg.clear();
+    }
+
+    void _receive_challenge_sparse(uint32 var_idx, const F_primitive& r)
+    {
+        F* dst_f = (var_idx == 0 || bookkeeping_f_swap == nullptr) ? bookkeeping_f : bookkeeping_f_swap;
+        bool f_is_bits = var_idx == 0 && initial_v_is_bits;
+        F_primitive one_minus_r = F_primitive::one() - r;
+        uint32 dst_active = _active_end() >> 1;
+        _with_src_v(var_idx, [&](auto src_v)
+        {
+            parallel_for(pool, dst_active, [&](uint32 thread_id, uint32 begin, uint32 end)
+            {
+                if (f_is_bits)
+                {
+                    _fold_f_range<true>(src_v, dst_f, begin, end, r, one_minus_r);
+                }
+                else
+                {
+                    _fold_f_range<false>(src_v, dst_f, begin, end, r, one_minus_r);
+                }
+            });
+        });
+        _pad_f(dst_f, dst_active, cur_eval_size >> 1);
+        if (dst_f != bookkeeping_f)
+        {
+            std::swap(bookkeeping_f, bookkeeping_f_swap);
+        }
+
+        // folds in place, entry n is written once the entries from n on are read
+        uint32 n = 0;
+        for (uint32 e = 0; e < sparse_ids.size(); n++)
+        {
+            uint32 i = sparse_ids[e] >> 1;
+            uint32 pair_bits;
+            F hg[2];
+            e = _sparse_pair(e, pair_bits, hg);
+            sparse_ids[n] = i;
+            sparse_hg[n] = _fold_pair(pair_bits, hg, r);
+        }
+        sparse_ids.resize(n);
+        sparse_hg.resize(n);
+
+        next_evals_ready = false;
+        cur_eval_size >>= 1;
+        active_size = dst_active;
+        sumcheck_var_idx++;
+        if (!use_sparse(n, cur_eval_size))
+        {
+            _densify();
+        }
+    }
+
+    std::vector<F> poly_eval_at(uint32 var_idx, uint32 degree)
+    {
+        if (next_evals_ready)
+        {
+            assert(var_idx == sumcheck_var_idx);
+            next_evals_ready = false;
+            return _finalize_evals(next_evals[0], next_evals[1], next_evals[2]);
+        }
+        if (sparse)
+        {
+            return _poly_eval_at_sparse(var_idx);
+        }
+
+        bool f_is_bits = var_idx == 0 && initial_v_is_bits;
+
+        uint32 active_end = _active_end();
+
+        // one partial (p0, p1, p2) per worker, reduced below in worker order
+        std::vector<F> partial_sums(3 * nb_workers(pool), F::zero());
+        _with_src_v(var_idx, [&](auto src_v)
+        {
+            parallel_for(pool, _nb_words(active_end), [&](uint32 thread_id, uint32 begin, uint32 end)
+            {
+                Accumulator<F> p0, p1, p2;
+                for (uint32 w = begin; w < end; w++)
+                {
+                    // all zero words, i.e. 32 pairs without any gate, are skipped with one test
+                    uint64 word = _word_below(gate_exists, w, active_end);
+                    if (f_is_bits)
+                    {
+                        _accumulate_word<true>(w, word, src_v, bookkeeping_hg, p0, p1, p2);
+                    }
+                    else
+                    {
+                        _accumulate_word(w, word, src_v, bookkeeping_hg, p0, p1, p2);
+                    }
+                }
+                partial_sums[thread_id * 3] = p0.result();
+                partial_sums[thread_id * 3 + 1] = p1.result();
+                partial_sums[thread_id * 3 + 2] = p2.result();
+            }, PARALLEL_GRAIN_SIZE / 64);
+        });
+
+        return _finalize_partial_sums(partial_sums);
+    }
+
+    // Sums the per worker partials of the next round, partial (p0, p1, p2) of worker t are at 3 * (t * stride)
+    void _set_next_evals(bool eval_next, const F* partial_sums, uint32 nb_workers, uint32 stride)
+    {
+        next_evals_ready = eval_next;
+        if (!eval_next)
+        {
+            return;
+        }
+        for (uint32 j = 0; j < 3; j++)
+        {
+            next_evals[j] = F::zero();
+            for (uint32 t = 0; t < nb_workers; t++)
+            {
+                next_evals[j] += partial_sums[3 * t * stride + j];
             }
         }
-        p2 = p1 * F(6) + p0 * F(3) - p2 * F(2);
-        return {p0, p1, p2};
     }
 
-    void receive_challenge(uint32 var_idx, const F_primitive& r, bool *gate_exists)
+    void receive_challenge(uint32 var_idx, const F_primitive& r)
     {
-        auto src_v = (var_idx == 0 ? initial_v : bookkeeping_f);
         assert(var_idx == sumcheck_var_idx && 0 <= var_idx && var_idx < nb_vars);
-        for (uint32 i = 0; i < (cur_eval_size >> 1); i++)
+        if (sparse)
+        {
+            _receive_challenge_sparse(var_idx, r);
+            return;
+        }
+
+        // at round zero f is read from initial_v, so the fold never aliases its source
+        F* dst_f = (var_idx == 0 || bookkeeping_f_swap == nullptr) ? bookkeeping_f : bookkeeping_f_swap;
+        F* dst_hg = bookkeeping_hg_swap == nullptr ? bookkeeping_hg : bookkeeping_hg_swap;
+        uint64* dst_gate_exists = gate_exists_swap == nullptr ? gate_exists : gate_exists_swap;
+
+        uint32 src_end = _active_end();
+        uint32 nb_src_words = _nb_words(src_end);
+        uint32 dst_size = cur_eval_size >> 1;
+        uint32 dst_active = src_end >> 1;
+        bool eval_next = var_idx + 1 < nb_vars;
+        bool f_is_bits = var_idx == 0 && initial_v_is_bits;
+        F_primitive one_minus_r = F_primitive::one() - r;
+        std::vector<F> partial_sums(3 * nb_workers(pool), F::zero());
+        // each dst word is folded from two src words, in place it never overwrites a word not yet read
+        _with_src_v(var_idx, [&](auto src_v)
         {
-            if (!gate_exists[i * 2] && !gate_exists[i * 2 + 1])
+            parallel_for(pool, _nb_words(dst_active), [&](uint32 thread_id, uint32 begin, uint32 end)
             {
-                gate_exists[i] = false;
-                for(uint32 j = 0; j < gkr::M31_field::vectorize_size; j++)
+                Accumulator<F> p0, p1, p2;
+                for (uint32 k = begin; k < end; k++)
                 {
-                    bookkeeping_f[i].elements[j] = src_v[2 * i].elements[j] + (src_v[2 * i + 1].elements[j] - src_v[2 * i].elements[j]) * r;
+                    uint64 src_words[2] = {_word_below(gate_exists, 2 * k, src_end), 2 * k + 1 < nb_src_words ? _word_below(gate_exists, 2 * k + 1, src_end) : 0};
+                    dst_gate_exists[k] = fold_bit_pairs(src_words[0]) | (fold_bit_pairs(src_words[1]) << 32);
+
+                    // v is dense up to the active entries, the claim v(r) is read from it at the end
+                    uint32 i_end = std::min(dst_active, (k + 1) * 64);
+                    if (f_is_bits)
+                    {
+                        _fold_f_range<true>(src_v, dst_f, k * 64, i_end, r, one_minus_r);
+                    }
+                    else
+                    {
+                        _fold_f_range<false>(src_v, dst_f, k * 64, i_end, r, one_minus_r);
+                    }
+                    if (i_end == dst_active)
+                    {
+                        _pad_f(dst_f, dst_active, dst_size);
+                    }
+
+                    for (uint32 half = 0; half < 2; half++)
+                    {
+                        _fold_hg_word(src_words[half], bookkeeping_hg + k * 128 + half * 64, dst_hg + k * 64 + half * 32, r);
+                    }
+
+                    if (eval_next)
+                    {
+                        _accumulate_word(k, dst_gate_exists[k], dst_f, dst_hg, p0, p1, p2);
+                    }
                 }
-                bookkeeping_hg[i] = 0;
+                partial_sums[thread_id * 3] = p0.result();
+                partial_sums[thread_id * 3 + 1] = p1.result();
+                partial_sums[thread_id * 3 + 2] = p2.result();
+            }, PARALLEL_GRAIN_SIZE / 64);
+        });
+
+        _set_next_evals(eval_next, partial_sums.data(), nb_workers(pool), 1);
+
+        if (dst_f != bookkeeping_f)
+        {
+            std::swap(bookkeeping_f, bookkeeping_f_swap);
+        }
+        if (dst_hg != bookkeeping_hg)
+        {
+            std::swap(bookkeeping_hg, bookkeeping_hg_swap);
+            std::swap(gate_exists, gate_exists_swap);
+        }
+
+        cur_eval_size >>= 1;
+        active_size = dst_active;
+        sumcheck_var_idx++;
+    }
+
+    // Round zero of several helpers over the same initial_v and the same gate_exists,
+    // i.e. the parallel repetitions of one layer. initial_v is read once for all of them.
+    static std::vector<std::vector<F>> poly_eval_at_round_zero(SumcheckMultiLinearProdHelper** helpers, uint32 nb_helpers, uint32 degree)
+    {
+        const SumcheckMultiLinearProdHelper& first = *helpers[0];
+        const W* src_v = first.initial_v;
+        const uint64* gate_exists = first.gate_exists;
+        bool f_is_bits = first.initial_v_is_bits;
+
+        // the repetitions of a layer are all sparse or all dense, the lists are walked one by one
+        if (first.sparse)
+        {
+            std::vector<std::vector<F>> evals(nb_helpers);
+            for (uint32 h = 0; h < nb_helpers; h++)
+            {
+                evals[h] = helpers[h]->poly_eval_at(0, degree);
             }
-            else
+            return evals;
+        }
+
+        uint32 active_end = first._active_end();
+        std::vector<F> partial_sums(3 * nb_helpers * nb_workers(first.pool), F::zero());
+        parallel_for(first.pool, _nb_words(active_end), [&](uint32 thread_id, uint32 begin, uint32 end)
+        {
+            std::vector<Accumulator<F>> p(3 * nb_helpers);
+            for (uint32 w = begin; w < end; w++)
             {
-                gate_exists[i] = true;
-                for(uint32 j = 0; j < gkr::M31_field::vectorize_size; j++)
+                // the 64 entries of initial_v under the word stay in cache across the helpers
+                uint64 word = _word_below(gate_exists, w, active_end);
+                for (uint32 h = 0; h < nb_helpers; h++)
                 {
-                    bookkeeping_f[i].elements[j] = src_v[2 * i].elements[j] + (src_v[2 * i + 1].elements[j] - src_v[2 * i].elements[j]) * r;
-                    bookkeeping_hg[i].elements[j] = bookkeeping_hg[2 * i].elements[j] + (bookkeeping_hg[2 * i + 1].elements[j] - bookkeeping_hg[2 * i].elements[j]) * r;
+                    const F* hg = helpers[h]->bookkeeping_hg;
+                    if (f_is_bits)
+                    {
+                        _accumulate_word<true>(w, word, src_v, hg, p[3 * h], p[3 * h + 1], p[3 * h + 2]);
+                    }
+                    else
+                    {
+                        _accumulate_word(w, word, src_v, hg, p[3 * h], p[3 * h + 1], p[3 * h + 2]);
+                    }
                 }
             }
-            
+            for (uint32 j = 0; j < 3 * nb_helpers; j++)
+            {
+                partial_sums[3 * nb_helpers * thread_id + j] = p[j].result();
+            }
+        }, PARALLEL_GRAIN_SIZE / 64);
+
+        std::vector<std::vector<F>> evals(nb_helpers);
+        for (uint32 h = 0; h < nb_helpers; h++)
+        {
+            F p0 = F::zero();
+            F p1 = F::zero();
+            F p2 = F::zero();
+            for (uint32 t = 0; t < nb_workers(first.pool); t++)
+            {
+                p0 += partial_sums[3 * (t * nb_helpers + h)];
+                p1 += partial_sums[3 * (t * nb_helpers + h) + 1];
+                p2 += partial_sums[3 * (t * nb_helpers + h) + 2];
+            }
+            evals[h] = _finalize_evals(p0, p1, p2);
         }
+        return evals;
+    }
 
-        cur_eval_size >>= 1;
-        sumcheck_var_idx++;
+    // Folds round zero of several helpers, see poly_eval_at_round_zero
+    static void receive_challenge_round_zero(SumcheckMultiLinearProdHelper** helpers, uint32 nb_helpers, const F_primitive* rs)
+    {
+        const SumcheckMultiLinearProdHelper& first = *helpers[0];
+        const W* src_v = first.initial_v;
+        const uint64* gate_exists = first.gate_exists;
+
+        bool f_is_bits = first.initial_v_is_bits;
+
+        if (first.sparse)
+        {
+            for (uint32 h = 0; h < nb_helpers; h++)
+            {
+                helpers[h]->receive_challenge(0, rs[h]);
+            }
+            return;
+        }
+
+        std::vector<F*> dst_f(nb_helpers), dst_hg(nb_helpers);
+        std::vector<uint64*> dst_gate_exists(nb_helpers);
+        std::vector<F_primitive> one_minus_rs(nb_helpers);
+        for (uint32 h = 0; h < nb_helpers; h++)
+        {
+            one_minus_rs[h] = F_primitive::one() - rs[h];
+            SumcheckMultiLinearProdHelper& helper = *helpers[h];
+            assert(helper.sumcheck_var_idx == 0 && helper.initial_v == src_v);
+            dst_f[h] = helper.bookkeeping_f;
+            dst_hg[h] = helper.bookkeeping_hg_swap == nullptr ? helper.bookkeeping_hg : helper.bookkeeping_hg_swap;
+            dst_gate_exists[h] = helper.gate_exists_swap == nullptr ? helper.gate_exists : helper.gate_exists_swap;
+        }
+
+        uint32 src_end = first._active_end();
+        uint32 nb_src_words = _nb_words(src_end);
+        uint32 dst_size = first.cur_eval_size >> 1;
+        uint32 dst_active = src_end >> 1;
+        bool eval_next = first.nb_vars > 1;
+        std::vector<F> partial_sums(3 * nb_helpers * nb_workers(first.pool), F::zero());
+        parallel_for(first.pool, _nb_words(dst_active), [&](uint32 thread_id, uint32 begin, uint32 end)
+        {
+            std::vector<Accumulator<F>> p(3 * nb_helpers);
+            for (uint32 k = begin; k < end; k++)
+            {
+                // read before any helper writes, the first helper may fold gate_exists in place
+                uint64 src_words[2] = {_word_below(gate_exists, 2 * k, src_end), 2 * k + 1 < nb_src_words ? _word_below(gate_exists, 2 * k + 1, src_end) : 0};
+                uint64 dst_word = fold_bit_pairs(src_words[0]) | (fold_bit_pairs(src_words[1]) << 32);
+
+                // the 128 source entries of the word stay in cache across the helpers
+                uint32 i_end = std::min(dst_active, (k + 1) * 64);
+                for (uint32 h = 0; h < nb_helpers; h++)
+                {
+                    if (f_is_bits)
+                    {
+                        _fold_f_range<true>(src_v, dst_f[h], k * 64, i_end, rs[h], one_minus_rs[h]);
+                    }
+                    else
+                    {
+                        _fold_f_range<false>(src_v, dst_f[h], k * 64, i_end, rs[h], one_minus_rs[h]);
+                    }
+                }
+                if (i_end == dst_active)
+                {
+                    for (uint32 h = 0; h < nb_helpers; h++)
+                    {
+                        _pad_f(dst_f[h], dst_active, dst_size);
+                    }
+                }
+
+                for (uint32 h = 0; h < nb_helpers; h++)
+                {
+                    const F* hg = helpers[h]->bookkeeping_hg;
+                    dst_gate_exists[h][k] = dst_word;
+                    for (uint32 half = 0; half < 2; half++)
+                    {
+                        _fold_hg_word(src_words[half], hg + k * 128 + half * 64, dst_hg[h] + k * 64 + half * 32, rs[h]);
+                    }
+
+                    if (eval_next)
+                    {
+                        _accumulate_word(k, dst_word, dst_f[h], dst_hg[h], p[3 * h], p[3 * h + 1], p[3 * h + 2]);
+                    }
+                }
+            }
+            for (uint32 j = 0; j < 3 * nb_helpers; j++)
+            {
+                partial_sums[3 * nb_helpers * thread_id + j] = p[j].result();
+            }
+        }, PARALLEL_GRAIN_SIZE / 64);
+
+        for (uint32 h = 0; h < nb_helpers; h++)
+        {
+            SumcheckMultiLinearProdHelper& helper = *helpers[h];
+            helper._set_next_evals(eval_next, partial_sums.data() + 3 * h, nb_workers(first.pool), nb_helpers);
+            if (dst_hg[h] != helper.bookkeeping_hg)
+            {
+                std::swap(helper.bookkeeping_hg, helper.bookkeeping_hg_swap);
+                std::swap(helper.gate_exists, helper.gate_exists_swap);
+            }
+            helper.cur_eval_size >>= 1;
+            helper.active_size = dst_active;
+            helper.sumcheck_var_idx++;
+        }
     }
 
 };
 
+// The power gates of phase one: \sum_x pw(x) v(x)^d, where pw(x) = \sum_z (alpha eq(rz1, z) + beta eq(rz2, z)) coef
+// over the gates z = coef x^d. The round polynomials have degree d + 1, evaluated at 0, ..., d + 1.
+// v is shared with the x_helper of the layer, only pw is folded here.
+template<typename F, typename F_primitive>
+class SumcheckPowHelper
+{
+public:
+    uint32 degree;
+    std::vector<F_primitive> pw, pw_swap;
+
+    template<CoefType ct>
+    static void _accumulate_pw(const GateCSR<F_primitive>& csr, const EqSqrtView<F_primitive>& eq_rz1, const EqSqrtView<F_primitive>& eq_rz2,
+        F_primitive* pw, ThreadPool* pool)
+    {
+        // the rows are distinct inputs, so they are split across threads without conflicts
+        parallel_for(pool, csr.nb_rows(), [&](uint32 thread_id, uint32 begin, uint32 end)
+        {
+            for (uint32 row = begin; row < end; row++)
+            {
+                F_primitive acc = F_primitive::zero();
+                for (uint32 i = csr.row_starts[row]; i < csr.row_starts[row + 1]; i++)
+                {
+                    acc += mul_coef<ct>(eq_rz1[csr.o_ids[i]] + eq_rz2[csr.o_ids[i]], csr.coefs[i]);
+                }
+                pw[csr.row_ids[row]] += acc;
+            }
+        });
+    }
+
+    void prepare(const SparseCircuitConnection<F_primitive, 1>& pow, uint32 degree_, uint32 nb_vars,
+        const EqSqrtView<F_primitive>& eq_rz1, const EqSqrtView<F_primitive>& eq_rz2, ThreadPool* pool)
+    {
+        degree = degree_;
+        pw.assign(1 << nb_vars, F_primitive::zero());
+        pw_swap.resize(pw.size() >> 1);
+        for_each_coef_type([&](auto coef_type)
+        {
+            constexpr CoefType ct = decltype(coef_type)::value;
+            _accumulate_pw<ct>(pow.template csr<ct>(0), eq_rz1, eq_rz2, pw.data(), pool);
+        });
+    }
+
+    // p(t) for t = 0, ..., degree + 1 over the pairs below active_end, where v is zero.
+    // v is the witness before the first fold
+    template<typename V>
+    std::vector<F> poly_eval_at(const V* src_v, uint32 active_end, ThreadPool* pool) const
+    {
+        uint32 nb_evals = degree + 2;
+        std::vector<F> partial_sums(nb_evals * nb_workers(pool), F::zero());
+        parallel_for(pool, active_end >> 1, [&](uint32 thread_id, uint32 begin, uint32 end)
+        {
+            std::vector<Accumulator<F>> acc(nb_evals);
+            for (uint32 i = begin; i < end; i++)
+            {
+                F v_t = src_v[2 * i];
+                F dv = src_v[2 * i + 1] - src_v[2 * i];
+                F_primitive w_t = pw[2 * i];
+                F_primitive dw = pw[2 * i + 1] - w_t;
+                for (uint32 t = 0; t < nb_evals; t++)
+                {
+                    acc[t].mul_add(pow_small(v_t, degree), w_t);
+                    v_t += dv;
+                    w_t += dw;
+                }
+            }
+            for (uint32 t = 0; t < nb_evals; t++)
+            {
+                partial_sums[thread_id * nb_evals + t] = acc[t].result();
+            }
+        });
+
+        std::vector<F> evals(nb_evals, F::zero());
+        for (uint32 i = 0; i < partial_sums.size(); i++)
+        {
+            evals[i % nb_evals] += partial_sums[i];
+        }
+        return evals;
+    }
+
+    // Folds every pair: the zero padding of v is paired with pw past the active entries
+    // from the second round on, so those have to stay exact as well
+    void receive_challenge(const F_primitive& r, ThreadPool* pool)
+    {
+        parallel_for(pool, pw.size() >> 1, [&](uint32 thread_id, uint32 begin, uint32 end)
+        {
+            for (uint32 i = begin; i < end; i++)
+            {
+                pw_swap[i] = pw[2 * i] + (pw[2 * i + 1] - pw[2 * i]) * r;
+            }
+        });
+        std::swap(pw, pw_swap);
+        pw_swap.resize(pw.size() >> 1);
+    }
+};
+
 // The basic version:
 //  Phase one:
 //  f(rz) = \sum_{x, y} mul(rz, x, y) v(x) v(y) + add(rz, x) v(x)
@@ -151,6 +883,8 @@ template<typename F, typename F_primitive>
 class SumcheckGKRHelper
 {
 public:
+    using W = witness_field_t<F>;
+
     std::vector<F_primitive> const *rz1_ptr, *rz2_ptr;
     CircuitLayer<F, F_primitive> const* poly_ptr;
     F_primitive alpha, beta;
@@ -158,119 +892,339 @@ public:
 
     std::vector<F_primitive> rx, ry;
 
+    // alpha eq(rz1, .), beta eq(rz2, .) and eq(rx, .) over the sqrt sized tables of the scratch pad
+    EqSqrtView<F_primitive> eq_rz1, eq_rz2, eq_rx;
+
     // x_helper: v(x)g(x), y_helper: v(y)h(y)
     // where v is the input layer evaluations
     // g and h are defined at the beginning of this template
     SumcheckMultiLinearProdHelper<F, F_primitive> x_helper, y_helper;
+    // pw(x) v(x)^d of the power gates, used in phase one of layers that have them
+    SumcheckPowHelper<F, F_primitive> pow_helper;
 
 public:
     uint32 nb_input_vars;
     uint32 nb_output_vars;
+    bool phase_two_prepared;
     
 public:
 
-    void _prepare_g_x_vals(
-        const std::vector<F_primitive>& rz1,
+    // hg is accumulated into, the gate bitset is precomputed by the layer.
+    // A sparse phase only clears the entries of its gates, the others are never read.
+    void _clear_bookkeeping(F* hg_vals, uint64* gate_exists, const std::vector<uint64>& gate_mask, const std::vector<uint32>& gate_ids, uint32 size)
+    {
+        if (SumcheckMultiLinearProdHelper<F, F_primitive>::use_sparse(gate_ids.size(), size))
+        {
+            parallel_for(pad_ptr->pool, gate_ids.size(), [&](uint32 thread_id, uint32 begin, uint32 end)
+            {
+                for (uint32 e = begin; e < end; e++)
+                {
+                    hg_vals[gate_ids[e]] = F::zero();
+                }
+            });
+            return;
+        }
+        // the entries past the active inputs are never read either
+        uint32 active_end = std::min(size, (poly_ptr->nb_active_inputs + 1) & ~1u);
+        parallel_for(pad_ptr->pool, active_end, [&](uint32 thread_id, uint32 begin, uint32 end)
+        {
+            std::fill(hg_vals + begin, hg_vals + end, F::zero());
+        });
+        memcpy(gate_exists, gate_mask.data(), sizeof(uint64) * bitset_nb_words(size));
+    }
+
+    // Phase one setup that does not touch the gate lists: clearing the bookkeeping and the eq tables
+    void _setup_phase_one(const CircuitLayer<F, F_primitive>& poly, 
+        const std::vector<F_primitive>& rz1, 
         const std::vector<F_primitive>& rz2,
-        const F_primitive& alpha,
-        const F_primitive& beta,
-        const SparseCircuitConnection<F_primitive, 2>& mul,
-        const SparseCircuitConnection<F_primitive, 1>& add, 
-        const MultiLinearPoly<F>& vals,
-        bool* gate_exists,
+        const F_primitive& alpha_,
+        const F_primitive& beta_,
+        GKRScratchPad<F, F_primitive>& scratch_pad,
         Timing &timer)
     {
+        nb_input_vars = poly.nb_input_vars;
+        nb_output_vars = poly.nb_output_vars;
+        rz1_ptr = &rz1;
+        rz2_ptr = &rz2;
+        alpha = alpha_;
+        beta = beta_;
+        poly_ptr = &poly;
+        pad_ptr = &scratch_pad;
+        phase_two_prepared = false;
+
         timer.add_timing("          prepare g_x_vals, _eq_evals_at");
-        F *hg_vals = pad_ptr->hg_evals;
-        memset(hg_vals, 0, sizeof(F) * vals.evals.size());
-        memset(gate_exists, 0, sizeof(bool) * vals.evals.size());
+        _clear_bookkeeping(pad_ptr->hg_evals, pad_ptr->gate_exists, poly.phase_one_gate_mask, poly.phase_one_gate_ids, 1 << nb_input_vars);
 
-        _eq_evals_at(rz1, alpha, pad_ptr->eq_evals_at_rz1, pad_ptr -> eq_evals_first_half, pad_ptr -> eq_evals_second_half);
-        _eq_evals_at(rz2, beta, pad_ptr->eq_evals_at_rz2, pad_ptr -> eq_evals_first_half, pad_ptr -> eq_evals_second_half);
+        eq_rz1 = _eq_evals_sqrt_at(rz1, alpha, pad_ptr->eq_evals_at_rz1_first_half, pad_ptr->eq_evals_at_rz1_second_half);
+        eq_rz2 = _eq_evals_sqrt_at(rz2, beta, pad_ptr->eq_evals_at_rz2_first_half, pad_ptr->eq_evals_at_rz2_second_half);
         timer.report_timing("          prepare g_x_vals, _eq_evals_at");
-        F_primitive * eq_evals_at_rz1 = pad_ptr->eq_evals_at_rz1;
-        F_primitive const* eq_evals_at_rz2 = pad_ptr->eq_evals_at_rz2;
-        for (int i = 0; i < (1 << rz1.size()); ++i)
+
+        if (poly.has_pow())
         {
-            eq_evals_at_rz1[i] = eq_evals_at_rz1[i] + eq_evals_at_rz2[i];
+            timer.add_timing("          prepare pw_x_vals");
+            pow_helper.prepare(poly.pow, poly.pow_degree, nb_input_vars, eq_rz1, eq_rz2, pad_ptr->pool);
+            timer.report_timing("          prepare pw_x_vals");
         }
+    }
 
-        auto mul_size = mul.sparse_evals.size();
-        timer.add_timing("          prepare g_x_vals, mul loop " + std::to_string(mul_size));
-        const Gate<F_primitive, 2>* mul_ptr = mul.sparse_evals.data();
-        const F* vals_eval_ptr = vals.evals.data();
-        timer.add_timing("          prepare g_x_vals, mul loop2 " + std::to_string(mul_size));
-        for(long unsigned int i = 0; i < mul_size; i++)
+    // Walks rows [row_begin, row_end) of csr in blocks of about GATE_BLOCK_SIZE gates. The weights
+    // eq(rz, z) (* eq(rx, other)) * coef of a block are computed for every helper with the vectorized
+    // gate_weights, then f(block_row_begin, block_row_end, weights) accumulates the block, where the
+    // weight of gate i for helper h is weights[h * block_size + i - row_starts[block_row_begin]]
+    template<CoefType ct, typename BlockKernel>
+    static void _for_each_weight_block(const GateCSR<F_primitive>& csr, uint32 row_begin, uint32 row_end,
+        const SumcheckGKRHelper* helpers, uint32 nb_helpers, bool with_rx, std::vector<F_primitive>& weights, BlockKernel&& f)
+    {
+        uint32 row = row_begin;
+        while (row < row_end)
         {
-            // g(x) += eq(rz, z) * v(y) * coef
-            const Gate<F_primitive, 2> &gate = mul_ptr[i];
-            uint32 x = gate.i_ids[0];
-            uint32 y = gate.i_ids[1];
-            uint32 z = gate.o_id;
+            uint32 block_end = row + 1;
+            while (block_end < row_end && csr.row_starts[block_end + 1] - csr.row_starts[row] <= GATE_BLOCK_SIZE)
+            {
+                block_end++;
+            }
+            uint32 gate_begin = csr.row_starts[row];
+            uint32 block_size = csr.row_starts[block_end] - gate_begin;
+            if (weights.size() < block_size * nb_helpers)
+            {
+                weights.resize(block_size * nb_helpers);
+            }
+            for (uint32 h = 0; h < nb_helpers; h++)
+            {
+                gate_weights<ct>(csr, gate_begin, gate_begin + block_size, helpers[h].eq_rz1, helpers[h].eq_rz2,
+                    with_rx ? &helpers[h].eq_rx : nullptr, weights.data() + h * block_size);
+            }
+            f(row, block_end, block_size, weights.data());
+            row = block_end;
+        }
+    }
+
+    // g(x) += eq(rz, z) * v(y) * coef over the mul gates of one coefficient type, grouped by x
+    template<CoefType ct, bool v_is_bits>
+    static void _accumulate_g_x_mul(const GateCSR<F_primitive>& mul, const W* vals_eval_ptr,
+        F* const* hg_vals, const SumcheckGKRHelper* helpers, uint32 nb_helpers, ThreadPool* pool)
+    {
+        parallel_for(pool, mul.nb_rows(), [&](uint32 thread_id, uint32 begin, uint32 end)
+        {
+            std::vector<Accumulator<F>> acc(nb_helpers);
+            std::vector<F_primitive> weights;
+            std::vector<F> products;
+            _for_each_weight_block<ct>(mul, begin, end, helpers, nb_helpers, false, weights,
+                [&](uint32 block_begin, uint32 block_end, uint32 block_size, const F_primitive* w)
+            {
+                uint32 gate_begin = mul.row_starts[block_begin];
+#ifdef GKR_HYPERCUBE_SIMD
+                // a single instance: v(y) * weight of the whole block is computed with gathers, the rows only add
+                if constexpr (std::is_same_v<F, M31_field::M31>)
+                {
+                    products.resize(nb_helpers * block_size);
+                    for (uint32 h = 0; h < nb_helpers; h++)
+                    {
+                        hypercube::gather_mul(vals_eval_ptr, mul.other_ids.data() + gate_begin, w + h * block_size, block_size, products.data() + h * block_size);
+                    }
+                }
+#endif
+                for (uint32 row = block_begin; row < block_end; row++)
+                {
+                    std::fill(acc.begin(), acc.end(), Accumulator<F>());
+                    for (uint32 i = mul.row_starts[row]; i < mul.row_starts[row + 1]; i++)
+                    {
+                        const W& v_y = vals_eval_ptr[mul.other_ids[i]];
+                        for (uint32 h = 0; h < nb_helpers; h++)
+                        {
+                            if (!products.empty())
+                            {
+                                acc[h].add(products[h * block_size + i - gate_begin]);
+                                continue;
+                            }
+                            SumcheckMultiLinearProdHelper<F, F_primitive>::template _mul_add_f<v_is_bits>(acc[h], v_y, w[h * block_size + i - gate_begin]);
+                        }
+                    }
+                    uint32 x = mul.row_ids[row];
+                    for (uint32 h = 0; h < nb_helpers; h++)
+                    {
+                        hg_vals[h][x] += acc[h].result();
+                    }
+                }
+            });
+        });
+    }
 
-            hg_vals[x] += vals_eval_ptr[y] * (gate.coef * eq_evals_at_rz1[z]);
-            gate_exists[x] = true;
+    // g(x) += eq(rz, x) * coef over the add gates of one coefficient type, grouped by x
+    template<CoefType ct>
+    static void _accumulate_g_x_add(const GateCSR<F_primitive>& add,
+        F* const* hg_vals, const SumcheckGKRHelper* helpers, uint32 nb_helpers, ThreadPool* pool)
+    {
+        parallel_for(pool, add.nb_rows(), [&](uint32 thread_id, uint32 begin, uint32 end)
+        {
+            std::vector<F_primitive> acc(nb_helpers);
+            std::vector<F_primitive> weights;
+            _for_each_weight_block<ct>(add, begin, end, helpers, nb_helpers, false, weights,
+                [&](uint32 block_begin, uint32 block_end, uint32 block_size, const F_primitive* w)
+            {
+                uint32 gate_begin = add.row_starts[block_begin];
+                for (uint32 row = block_begin; row < block_end; row++)
+                {
+                    std::fill(acc.begin(), acc.end(), F_primitive::zero());
+                    for (uint32 i = add.row_starts[row]; i < add.row_starts[row + 1]; i++)
+                    {
+                        for (uint32 h = 0; h < nb_helpers; h++)
+                        {
+                            acc[h] += w[h * block_size + i - gate_begin];
+                        }
+                    }
+                    uint32 x = add.row_ids[row];
+                    for (uint32 h = 0; h < nb_helpers; h++)
+                    {
+                        hg_vals[h][x] = hg_vals[h][x] + acc[h];
+                    }
+                }
+            });
+        });
+    }
+
+    // g(x) of several helpers proving the same layer, i.e. the parallel repetitions.
+    // The gates are read from the layouts compiled by x, so each row sums into registers and
+    // writes hg_evals[x] once, and rows are split across threads without conflicts.
+    static void _prepare_g_x_vals(SumcheckGKRHelper* helpers, uint32 nb_helpers, Timing &timer)
+    {
+        const CircuitLayer<F, F_primitive>& poly = *helpers[0].poly_ptr;
+        const SparseCircuitConnection<F_primitive, 2>& mul = poly.mul;
+        const SparseCircuitConnection<F_primitive, 1>& add = poly.add;
+        ThreadPool* pool = helpers[0].pad_ptr->pool;
+
+        std::vector<F*> hg_vals(nb_helpers);
+        for (uint32 h = 0; h < nb_helpers; h++)
+        {
+            hg_vals[h] = helpers[h].pad_ptr->hg_evals;
         }
+
+        auto mul_size = mul.sparse_evals.size();
+        timer.add_timing("          prepare g_x_vals, mul loop " + std::to_string(mul_size));
+        const W* vals_eval_ptr = poly.input_layer_vals.evals.data();
+        for_each_coef_type([&](auto coef_type)
+        {
+            constexpr CoefType ct = decltype(coef_type)::value;
+            if (poly.input_is_bits)
+            {
+                _accumulate_g_x_mul<ct, true>(mul.template csr<ct>(0), vals_eval_ptr, hg_vals.data(), helpers, nb_helpers, pool);
+            }
+            else
+            {
+                _accumulate_g_x_mul<ct, false>(mul.template csr<ct>(0), vals_eval_ptr, hg_vals.data(), helpers, nb_helpers, pool);
+            }
+        });
         timer.report_timing("          prepare g_x_vals, mul loop " + std::to_string(mul_size));
-        timer.report_timing("          prepare g_x_vals, mul loop2 " + std::to_string(mul_size));
         
         auto add_size = add.sparse_evals.size();
 
         timer.add_timing("          prepare g_x_vals, add loop" + std::to_string(add_size));
-        const auto add_ptr = add.sparse_evals.data();
-        for(long unsigned int i = 0; i < add_size; i++)
+        for_each_coef_type([&](auto coef_type)
         {
-            // g(x) += eq(rz, x) * coef
-            const auto &gate = add_ptr[i];
-            uint32 x = gate.i_ids[0];
-            uint32 z = gate.o_id;
-            hg_vals[x] = hg_vals[x] + gate.coef * eq_evals_at_rz1[z];
-            gate_exists[x] = true;
-        }
+            constexpr CoefType ct = decltype(coef_type)::value;
+            _accumulate_g_x_add<ct>(add.template csr<ct>(0), hg_vals.data(), helpers, nb_helpers, pool);
+        });
         timer.report_timing("          prepare g_x_vals, add loop" + std::to_string(add_size));
     }
 
-    void _prepare_h_y_vals(
-        const std::vector<F_primitive>& rx,
-        const F& v_rx,
-        const SparseCircuitConnection<F_primitive, 2>& mul,
-        bool *gate_exists,
-        Timing &timer)
+    void _setup_phase_two(Timing &timer)
     {
         timer.add_timing("          prepare h_y_vals, _eq_evals_at");
-        F *hg_vals = pad_ptr->hg_evals;
-        memset(hg_vals, 0, sizeof(F) * (1 << rx.size()));
-        memset(gate_exists, 0, sizeof(bool) * (1 << rx.size()));
-
-        F_primitive const* eq_evals_at_rz1 = pad_ptr->eq_evals_at_rz1; // already computed in g_x preparation
-        _eq_evals_at(rx, F_primitive::one(), pad_ptr->eq_evals_at_rx, pad_ptr -> eq_evals_first_half, pad_ptr -> eq_evals_second_half);
-        F_primitive const* eq_evals_at_rx = pad_ptr->eq_evals_at_rx;
+        _clear_bookkeeping(pad_ptr->hg_evals, pad_ptr->gate_exists, poly_ptr->phase_two_gate_mask, poly_ptr->phase_two_gate_ids, 1 << nb_input_vars);
+        eq_rx = _eq_evals_sqrt_at(rx, F_primitive::one(), pad_ptr->eq_evals_at_rx_first_half, pad_ptr->eq_evals_at_rx_second_half);
         timer.report_timing("          prepare h_y_vals, _eq_evals_at");
-        timer.add_timing("          prepare h_y_vals, loop");
-        for(const Gate<F_primitive, 2>& gate: mul.sparse_evals)
+    }
+
+    // h(y) += eq(rz, z) * eq(rx, x) * v(rx) * coef over the mul gates of one coefficient type, grouped by y.
+    // v(rx) is common to a row so it is applied once per row rather than once per gate.
+    template<CoefType ct>
+    static void _accumulate_h_y(const GateCSR<F_primitive>& mul, const F* v_rx,
+        F* const* hg_vals, const SumcheckGKRHelper* helpers, uint32 nb_helpers, ThreadPool* pool)
+    {
+        parallel_for(pool, mul.nb_rows(), [&](uint32 thread_id, uint32 begin, uint32 end)
         {
-            // g(y) += eq(rz, z) * eq(rx, x) * v(y) * coef
-            uint32 x = gate.i_ids[0];
-            uint32 y = gate.i_ids[1];
-            uint32 z = gate.o_id;
+            std::vector<F_primitive> acc(nb_helpers);
+            std::vector<F_primitive> weights;
+            _for_each_weight_block<ct>(mul, begin, end, helpers, nb_helpers, true, weights,
+                [&](uint32 block_begin, uint32 block_end, uint32 block_size, const F_primitive* w)
+            {
+                uint32 gate_begin = mul.row_starts[block_begin];
+                for (uint32 row = block_begin; row < block_end; row++)
+                {
+                    std::fill(acc.begin(), acc.end(), F_primitive::zero());
+                    for (uint32 i = mul.row_starts[row]; i < mul.row_starts[row + 1]; i++)
+                    {
+                        for (uint32 h = 0; h < nb_helpers; h++)
+                        {
+                            acc[h] += w[h * block_size + i - gate_begin];
+                        }
+                    }
+                    uint32 y = mul.row_ids[row];
+                    for (uint32 h = 0; h < nb_helpers; h++)
+                    {
+                        hg_vals[h][y] += v_rx[h] * acc[h];
+                    }
+                }
+            });
+        });
+    }
+
+    // h(y) of several helpers in one pass over the mul gates compiled by y, see _prepare_g_x_vals
+    static void _prepare_h_y_vals(SumcheckGKRHelper* helpers, uint32 nb_helpers, Timing &timer)
+    {
+        const SparseCircuitConnection<F_primitive, 2>& mul = helpers[0].poly_ptr->mul;
+        ThreadPool* pool = helpers[0].pad_ptr->pool;
 
-            hg_vals[y] += v_rx * (eq_evals_at_rz1[z] * eq_evals_at_rx[x] * gate.coef);
-            gate_exists[y] = true;
+        std::vector<F*> hg_vals(nb_helpers);
+        std::vector<F> v_rx(nb_helpers);
+        for (uint32 h = 0; h < nb_helpers; h++)
+        {
+            hg_vals[h] = helpers[h].pad_ptr->hg_evals;
+            v_rx[h] = helpers[h].vx_claim();
         }
+
+        timer.add_timing("          prepare h_y_vals, loop");
+        for_each_coef_type([&](auto coef_type)
+        {
+            constexpr CoefType ct = decltype(coef_type)::value;
+            _accumulate_h_y<ct>(mul.template csr<ct>(1), v_rx.data(), hg_vals.data(), helpers, nb_helpers, pool);
+        });
         timer.report_timing("          prepare h_y_vals, loop");
     }
 
-    void _prepare_phase_two(Timing &timer)
+    static void _prepare_phase_two(SumcheckGKRHelper* helpers, uint32 nb_helpers, Timing &timer)
     {
         timer.add_timing("      prepare phase two, _prepare_h_y_vals");
-        _prepare_h_y_vals(rx, vx_claim(), poly_ptr->mul, pad_ptr->gate_exists, timer);
+        for (uint32 h = 0; h < nb_helpers; h++)
+        {
+            helpers[h]._setup_phase_two(timer);
+        }
+        _prepare_h_y_vals(helpers, nb_helpers, timer);
         timer.report_timing("      prepare phase two, _prepare_h_y_vals");
         timer.add_timing("      prepare phase two, prepare");
-        // TODO: may use the memory v_x_evals as long as the value vx_claim is saved
-        y_helper.prepare(nb_input_vars, pad_ptr->v_evals, pad_ptr->hg_evals, poly_ptr->input_layer_vals.evals.data());
+        for (uint32 h = 0; h < nb_helpers; h++)
+        {
+            SumcheckGKRHelper& helper = helpers[h];
+            GKRScratchPad<F, F_primitive>* pad = helper.pad_ptr;
+            // TODO: may use the memory v_x_evals as long as the value vx_claim is saved
+            helper.y_helper.prepare(helper.nb_input_vars, pad->v_evals, pad->hg_evals, helper.poly_ptr->input_layer_vals.evals.data(), pad->gate_exists,
+                pad->pool, pad->v_evals_swap, pad->hg_evals_swap, pad->gate_exists_swap);
+            helper.y_helper.initial_v_is_bits = helper.poly_ptr->input_is_bits;
+            helper.y_helper.set_active_size(helper.poly_ptr->nb_active_inputs);
+            if (helper.y_helper.use_sparse(helper.poly_ptr->phase_two_gate_ids.size(), 1 << helper.nb_input_vars))
+            {
+                helper.y_helper.prepare_sparse(helper.poly_ptr->phase_two_gate_ids);
+            }
+            helper.phase_two_prepared = true;
+        }
         timer.report_timing("      prepare phase two, prepare");
     }
 
+    SumcheckMultiLinearProdHelper<F, F_primitive>& _helper_at(uint32 var_idx)
+    {
+        return var_idx < nb_input_vars ? x_helper : y_helper;
+    }
+
 public:
 
     void prepare(const CircuitLayer<F, F_primitive>& poly, 
@@ -281,63 +1235,138 @@ public:
         GKRScratchPad<F, F_primitive>& scratch_pad,
         Timing &timer)
     {
-        nb_input_vars = poly.nb_input_vars;
-        nb_output_vars = poly.nb_output_vars;
-        rz1_ptr = &rz1;
-        rz2_ptr = &rz2;
-        alpha = alpha_;
-        beta = beta_;
-        poly_ptr = &poly;
-        pad_ptr = &scratch_pad;
+        prepare_repetitions(this, 1, poly, &rz1, &rz2, alpha_, beta_, &scratch_pad, timer);
+    }
 
+    // Prepares one helper per repetition of the same layer with a single pass over the gate lists
+    static void prepare_repetitions(SumcheckGKRHelper* helpers, uint32 nb_helpers,
+        const CircuitLayer<F, F_primitive>& poly, 
+        const std::vector<F_primitive>* rz1s, 
+        const std::vector<F_primitive>* rz2s,
+        const F_primitive& alpha_,
+        const F_primitive& beta_,
+        GKRScratchPad<F, F_primitive>* scratch_pads,
+        Timing &timer)
+    {
         // phase one
         timer.add_timing("      prepare phase one, _prepare_g_x_vals");
-        _prepare_g_x_vals(rz1, rz2, alpha, beta, poly.mul, poly.add, poly.input_layer_vals, pad_ptr->gate_exists, timer);
+        for (uint32 h = 0; h < nb_helpers; h++)
+        {
+            helpers[h]._setup_phase_one(poly, rz1s[h], rz2s[h], alpha_, beta_, scratch_pads[h], timer);
+        }
+        _prepare_g_x_vals(helpers, nb_helpers, timer);
         timer.report_timing("      prepare phase one, _prepare_g_x_vals");
         timer.add_timing("      prepare phase one, prepare");
-        x_helper.prepare(nb_input_vars, pad_ptr->v_evals, pad_ptr->hg_evals, poly.input_layer_vals.evals.data());
+        for (uint32 h = 0; h < nb_helpers; h++)
+        {
+            SumcheckGKRHelper& helper = helpers[h];
+            GKRScratchPad<F, F_primitive>* pad = helper.pad_ptr;
+            helper.x_helper.prepare(helper.nb_input_vars, pad->v_evals, pad->hg_evals, poly.input_layer_vals.evals.data(), pad->gate_exists,
+                pad->pool, pad->v_evals_swap, pad->hg_evals_swap, pad->gate_exists_swap);
+            helper.x_helper.initial_v_is_bits = poly.input_is_bits;
+            helper.x_helper.set_active_size(poly.nb_active_inputs);
+            if (helper.x_helper.use_sparse(poly.phase_one_gate_ids.size(), 1 << helper.nb_input_vars))
+            {
+                helper.x_helper.prepare_sparse(poly.phase_one_gate_ids);
+            }
+        }
         timer.report_timing("      prepare phase one, prepare");
     }
 
+    static void prepare_phase_two_repetitions(SumcheckGKRHelper* helpers, uint32 nb_helpers, Timing &timer)
+    {
+        _prepare_phase_two(helpers, nb_helpers, timer);
+    }
+
     std::vector<F> poly_evals_at(uint32 var_idx, uint32 degree, Timing &timer)
     {
         if (var_idx < nb_input_vars)
         {
-            return x_helper.poly_eval_at(var_idx, degree, pad_ptr->gate_exists);
+            std::vector<F> evals = x_helper.poly_eval_at(var_idx, degree);
+            if (!poly_ptr->has_pow())
+            {
+                return evals;
+            }
+            // v g is extended from degree 2 to the points of the power gate part
+            std::vector<F> pow_evals = x_helper._with_src_v(var_idx, [&](auto src_v)
+            {
+                return pow_helper.poly_eval_at(src_v, x_helper._active_end(), pad_ptr->pool);
+            });
+            for (uint32 t = 3; t < pow_evals.size(); t++)
+            {
+                evals.emplace_back(degree_2_eval(evals, F_primitive(t)));
+            }
+            for (uint32 t = 0; t < pow_evals.size(); t++)
+            {
+                evals[t] += pow_evals[t];
+            }
+            return evals;
         }
         else 
         {
-            if (var_idx == nb_input_vars)
+            if (var_idx == nb_input_vars && !phase_two_prepared)
             {
-                _prepare_phase_two(timer);
+                _prepare_phase_two(this, 1, timer);
             }
             
-            return y_helper.poly_eval_at(var_idx - nb_input_vars, degree, pad_ptr->gate_exists);
+            return y_helper.poly_eval_at(var_idx - nb_input_vars, degree);
         }
     }
 
+    // The first round of either phase reads the shared input layer values directly,
+    // the repetitions evaluate and fold it together so it is streamed once
+    static bool is_round_zero(uint32 var_idx, uint32 nb_input_vars)
+    {
+        return var_idx == 0 || var_idx == nb_input_vars;
+    }
+
+    static std::vector<std::vector<F>> poly_evals_at_round_zero(SumcheckGKRHelper* helpers, uint32 nb_helpers, uint32 var_idx, uint32 degree)
+    {
+        std::vector<SumcheckMultiLinearProdHelper<F, F_primitive>*> prod_helpers(nb_helpers);
+        for (uint32 h = 0; h < nb_helpers; h++)
+        {
+            prod_helpers[h] = &helpers[h]._helper_at(var_idx);
+        }
+        return SumcheckMultiLinearProdHelper<F, F_primitive>::poly_eval_at_round_zero(prod_helpers.data(), nb_helpers, degree);
+    }
+
+    static void receive_challenge_round_zero(SumcheckGKRHelper* helpers, uint32 nb_helpers, uint32 var_idx, const std::vector<F_primitive>& rs)
+    {
+        std::vector<SumcheckMultiLinearProdHelper<F, F_primitive>*> prod_helpers(nb_helpers);
+        for (uint32 h = 0; h < nb_helpers; h++)
+        {
+            prod_helpers[h] = &helpers[h]._helper_at(var_idx);
+            (var_idx < helpers[h].nb_input_vars ? helpers[h].rx : helpers[h].ry).emplace_back(rs[h]);
+        }
+        SumcheckMultiLinearProdHelper<F, F_primitive>::receive_challenge_round_zero(prod_helpers.data(), nb_helpers, rs.data());
+    }
+
     void receive_challenge(uint32 var_idx, const F_primitive& r)
     {
         if (var_idx < nb_input_vars)
         {
-            x_helper.receive_challenge(var_idx, r, pad_ptr->gate_exists);
+            if (poly_ptr->has_pow())
+            {
+                pow_helper.receive_challenge(r, pad_ptr->pool);
+            }
+            x_helper.receive_challenge(var_idx, r);
             rx.emplace_back(r);
         }
         else 
         {
-            y_helper.receive_challenge(var_idx - nb_input_vars, r, pad_ptr->gate_exists);
+            y_helper.receive_challenge(var_idx - nb_input_vars, r);
             ry.emplace_back(r);
         }
     }
 
     F vx_claim()
     {
-        return pad_ptr->v_evals[0];
+        return x_helper.bookkeeping_f[0];
     }
 
     F vy_claim()
     {
-        return pad_ptr->v_evals[0];
+        return y_helper.bookkeeping_f[0];
     }
 };
 
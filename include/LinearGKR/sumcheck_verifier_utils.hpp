@@ -17,6 +17,32 @@ F degree_2_eval(const std::vector<F>& vals, const F_primitive& x)
     return c0 + (c2 * x + c1) * x;
 }
 
+// Given f(0), ..., f(d) of a degree d poly, evaluate it at x by Lagrange interpolation
+template<typename F, typename F_primitive>
+F eval_from_evals(const std::vector<F>& vals, const F_primitive& x)
+{
+    if (vals.size() == 3)
+    {
+        return degree_2_eval(vals, x);
+    }
+    F v = F::zero();
+    for (uint32 i = 0; i < vals.size(); i++)
+    {
+        F_primitive num = F_primitive::one();
+        F_primitive den = F_primitive::one();
+        for (uint32 j = 0; j < vals.size(); j++)
+        {
+            if (j != i)
+            {
+                num *= x - F_primitive(j);
+                den *= F_primitive(i) - F_primitive(j);
+            }
+        }
+        v += vals[i] * (num * den.inv());
+    }
+    return v;
+}
+
 // eval alpha add(rz1, rx) + beta add(rz2, rx)
 // or alpha mul(rz1, rx, ry) + beta mul(rz2, rx, ry)
 template<typename F, typename F_primitive, uint32 nb_input>
@@ -28,30 +54,57 @@ F_primitive eval_sparse_circuit_connect_poly(
     const F_primitive& beta,
     const std::vector<std::vector<F_primitive>>& ris)
 {
-    std::vector<F_primitive> eq_evals_at_rz1(1 << rz1.size());
-    std::vector<F_primitive> eq_evals_at_rz2(1 << rz2.size());
-
-    _eq_evals_at_primitive(rz1, alpha, eq_evals_at_rz1.data());
-    _eq_evals_at_primitive(rz2, beta, eq_evals_at_rz2.data());
+    std::vector<F_primitive> eq_rz1_halves(2 * eq_sqrt_table_size(rz1.size()));
+    std::vector<F_primitive> eq_rz2_halves(2 * eq_sqrt_table_size(rz2.size()));
+    EqSqrtView<F_primitive> eq_rz1 = _eq_evals_sqrt_at(rz1, alpha, eq_rz1_halves.data(), eq_rz1_halves.data() + eq_sqrt_table_size(rz1.size()));
+    EqSqrtView<F_primitive> eq_rz2 = _eq_evals_sqrt_at(rz2, beta, eq_rz2_halves.data(), eq_rz2_halves.data() + eq_sqrt_table_size(rz2.size()));
     
-    std::vector<std::vector<F_primitive>> eq_evals_at_ris(nb_input);
+    std::vector<std::vector<F_primitive>> eq_ris_halves(nb_input);
+    std::vector<EqSqrtView<F_primitive>> eq_ris(nb_input);
     for (uint32 i = 0; i < nb_input; i++)
     {
-        eq_evals_at_ris[i].resize(1 << (ris[i].size()));
-        _eq_evals_at_primitive(ris[i], F_primitive::one(), eq_evals_at_ris[i].data());
+        uint32 table_size = eq_sqrt_table_size(ris[i].size());
+        eq_ris_halves[i].resize(2 * table_size);
+        eq_ris[i] = _eq_evals_sqrt_at(ris[i], F_primitive::one(), eq_ris_halves[i].data(), eq_ris_halves[i].data() + table_size);
     }
     
     F_primitive v = F_primitive::zero();
-    for (const Gate<F_primitive, nb_input>& gate: poly.sparse_evals)
+    for_each_coef_type([&](auto coef_type)
     {
-        auto prod = (eq_evals_at_rz1[gate.o_id] + eq_evals_at_rz2[gate.o_id]);
-        for (uint32 i = 0; i < nb_input; i++)
+        constexpr CoefType ct = decltype(coef_type)::value;
+        for (auto gate = poly.template gates_begin<ct>(); gate != poly.template gates_end<ct>(); gate++)
         {
-            prod *= eq_evals_at_ris[i][gate.i_ids[i]];
+            auto prod = eq_rz1[gate->o_id] + eq_rz2[gate->o_id];
+            for (uint32 i = 0; i < nb_input; i++)
+            {
+                prod *= eq_ris[i][gate->i_ids[i]];
+            }
+            v += mul_coef<ct>(prod, gate->coef);
         }
-        v += prod * gate.coef;
-    }
+    });
+
+    return v;
+}
+
+// eval alpha cst(rz1) + beta cst(rz2), one term per constant
+template<typename F_primitive>
+F_primitive eval_sparse_const_poly(
+    const ConstConnection<F_primitive>& poly,
+    const std::vector<F_primitive>& rz1,
+    const std::vector<F_primitive>& rz2,
+    const F_primitive& alpha,
+    const F_primitive& beta)
+{
+    std::vector<F_primitive> eq_rz1_halves(2 * eq_sqrt_table_size(rz1.size()));
+    std::vector<F_primitive> eq_rz2_halves(2 * eq_sqrt_table_size(rz2.size()));
+    EqSqrtView<F_primitive> eq_rz1 = _eq_evals_sqrt_at(rz1, alpha, eq_rz1_halves.data(), eq_rz1_halves.data() + eq_sqrt_table_size(rz1.size()));
+    EqSqrtView<F_primitive> eq_rz2 = _eq_evals_sqrt_at(rz2, beta, eq_rz2_halves.data(), eq_rz2_halves.data() + eq_sqrt_table_size(rz2.size()));
 
+    F_primitive v = F_primitive::zero();
+    for (const ConstGate<F_primitive>& gate: poly.sparse_evals)
+    {
+        v += (eq_rz1[gate.o_id] + eq_rz2[gate.o_id]) * gate.coef;
+    }
     return v;
 }
 
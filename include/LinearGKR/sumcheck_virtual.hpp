@@ -0,0 +1,249 @@
+#pragma once
+
+#include "utils/myutil.hpp"
+#include "utils/thread_pool.hpp"
+#include "fiat_shamir/transcript.hpp"
+#include "sumcheck.hpp"
+#include "sumcheck_verifier_utils.hpp"
+
+namespace gkr
+{
+
+// Sumcheck of \sum_x combine(g_1(x), ..., g_k(x)) over k multilinear tables, where combine is
+// a polynomial of total degree at most degree, e.g. g_1 g_2 g_3 for a product check or
+// g_1 (g_2 + c) for a lookup. combine(g) is called with the k values of the tables at one point.
+// The round polynomials are evaluated at 0, ..., degree from the pairs of every table;
+// the fold of a round also evaluates the next one while the folded pairs are in cache.
+template<typename F, typename F_primitive>
+class SumcheckVirtualPolyHelper
+{
+public:
+    uint32 nb_vars;
+    uint32 nb_tables;
+    uint32 degree;
+    uint32 sumcheck_var_idx;
+    uint32 cur_eval_size;
+    ThreadPool* pool;
+
+    // table k is at tables[k], folded into tables_swap[k] and swapped
+    std::vector<std::vector<F>> tables, tables_swap;
+
+    bool next_evals_ready;
+    std::vector<F> next_evals;
+
+    void prepare(const std::vector<const F*>& tables_, uint32 nb_vars_, uint32 degree_, ThreadPool* pool_ = nullptr)
+    {
+        nb_vars = nb_vars_;
+        nb_tables = tables_.size();
+        degree = degree_;
+        sumcheck_var_idx = 0;
+        cur_eval_size = 1 << nb_vars;
+        pool = pool_;
+        next_evals_ready = false;
+        tables.resize(nb_tables);
+        tables_swap.resize(nb_tables);
+        for (uint32 k = 0; k < nb_tables; k++)
+        {
+            tables[k].assign(tables_[k], tables_[k] + cur_eval_size);
+            tables_swap[k].resize(cur_eval_size >> 1);
+        }
+    }
+
+    // acc[t] += combine(g(t)) for t = 0, ..., degree on the line through g_0 = g(0) and g_1 = g(1).
+    // g_0 is overwritten.
+    template<typename Combine>
+    void _accumulate_pair(F* g_0, const F* g_1, F* diff, Accumulator<F>* acc, const Combine& combine) const
+    {
+        for (uint32 k = 0; k < nb_tables; k++)
+        {
+            diff[k] = g_1[k] - g_0[k];
+        }
+        acc[0].add(combine(g_0));
+        for (uint32 t = 1; t <= degree; t++)
+        {
+            for (uint32 k = 0; k < nb_tables; k++)
+            {
+                g_0[k] += diff[k];
+            }
+            acc[t].add(combine(g_0));
+        }
+    }
+
+    // Pairs per worker, an iteration costs about degree * nb_tables field operations
+    uint32 _grain() const
+    {
+        return std::max(1u, PARALLEL_GRAIN_SIZE / std::max(1u, degree * nb_tables));
+    }
+
+    // Sums the per worker partials, degree + 1 of them per worker, in worker order
+    std::vector<F> _reduce(const std::vector<F>& partial_sums) const
+    {
+        std::vector<F> evals(degree + 1, F::zero());
+        for (uint32 i = 0; i < partial_sums.size(); i++)
+        {
+            evals[i % (degree + 1)] += partial_sums[i];
+        }
+        return evals;
+    }
+
+    template<typename Combine>
+    std::vector<F> poly_eval_at(uint32 var_idx, const Combine& combine)
+    {
+        assert(var_idx == sumcheck_var_idx);
+        if (next_evals_ready)
+        {
+            next_evals_ready = false;
+            return next_evals;
+        }
+
+        std::vector<F> partial_sums((degree + 1) * nb_workers(pool), F::zero());
+        parallel_for(pool, cur_eval_size >> 1, [&](uint32 thread_id, uint32 begin, uint32 end)
+        {
+            std::vector<Accumulator<F>> acc(degree + 1);
+            std::vector<F> g(3 * nb_tables);
+            for (uint32 i = begin; i < end; i++)
+            {
+                for (uint32 k = 0; k < nb_tables; k++)
+                {
+                    g[k] = tables[k][2 * i];
+                    g[nb_tables + k] = tables[k][2 * i + 1];
+                }
+                _accumulate_pair(g.data(), g.data() + nb_tables, g.data() + 2 * nb_tables, acc.data(), combine);
+            }
+            for (uint32 t = 0; t <= degree; t++)
+            {
+                partial_sums[thread_id * (degree + 1) + t] = acc[t].result();
+            }
+        }, _grain());
+        return _reduce(partial_sums);
+    }
+
+    // Folds every table with r, each pair of the folded tables is evaluated for the next round right away
+    template<typename Combine>
+    void receive_challenge(uint32 var_idx, const F_primitive& r, const Combine& combine)
+    {
+        assert(var_idx == sumcheck_var_idx && var_idx < nb_vars);
+        uint32 dst_size = cur_eval_size >> 1;
+        bool eval_next = dst_size > 1;
+        std::vector<F> partial_sums((degree + 1) * nb_workers(pool), F::zero());
+        // one iteration per pair of the folded tables, i.e. per two pairs of the current ones
+        parallel_for(pool, std::max(1u, dst_size >> 1), [&](uint32 thread_id, uint32 begin, uint32 end)
+        {
+            std::vector<Accumulator<F>> acc(degree + 1);
+            std::vector<F> g(3 * nb_tables);
+            for (uint32 j = begin; j < end; j++)
+            {
+                for (uint32 k = 0; k < nb_tables; k++)
+                {
+                    const F* src = tables[k].data() + 4 * j;
+                    F* dst = tables_swap[k].data() + 2 * j;
+                    dst[0] = src[0] + (src[1] - src[0]) * r;
+                    if (eval_next)
+                    {
+                        dst[1] = src[2] + (src[3] - src[2]) * r;
+                        g[k] = dst[0];
+                        g[nb_tables + k] = dst[1];
+                    }
+                }
+                if (eval_next)
+                {
+                    _accumulate_pair(g.data(), g.data() + nb_tables, g.data() + 2 * nb_tables, acc.data(), combine);
+                }
+            }
+            for (uint32 t = 0; t <= degree; t++)
+            {
+                partial_sums[thread_id * (degree + 1) + t] = acc[t].result();
+            }
+        }, _grain());
+
+        next_evals_ready = eval_next;
+        if (eval_next)
+        {
+            next_evals = _reduce(partial_sums);
+        }
+        for (uint32 k = 0; k < nb_tables; k++)
+        {
+            std::swap(tables[k], tables_swap[k]);
+            tables_swap[k].resize(dst_size >> 1);
+        }
+        cur_eval_size = dst_size;
+        sumcheck_var_idx++;
+    }
+
+    // g_k(r) of every table once all variables are bound
+    std::vector<F> final_evals() const
+    {
+        std::vector<F> evals(nb_tables);
+        for (uint32 k = 0; k < nb_tables; k++)
+        {
+            evals[k] = tables[k][0];
+        }
+        return evals;
+    }
+};
+
+// Proves \sum_x combine(g_1(x), ..., g_k(x)) = claimed sum, see SumcheckVirtualPolyHelper.
+// The final values g_k(r) are appended to the transcript and returned with r,
+// they are left to be opened by the caller.
+template<typename F, typename F_primitive, typename Combine>
+std::tuple<std::vector<F_primitive>, std::vector<F>> sumcheck_prove_virtual(
+    const std::vector<const F*>& tables,
+    uint32 nb_vars,
+    uint32 degree,
+    const Combine& combine,
+    Transcript<F, F_primitive>& transcript,
+    ThreadPool* pool = nullptr
+)
+{
+    SumcheckVirtualPolyHelper<F, F_primitive> helper;
+    helper.prepare(tables, nb_vars, degree, pool);
+    std::vector<F_primitive> rs;
+    for (uint32 i_var = 0; i_var < nb_vars; i_var++)
+    {
+        append_round_message(transcript, helper.poly_eval_at(i_var, combine));
+        F_primitive r = transcript.challenge_f();
+        helper.receive_challenge(i_var, r, combine);
+        rs.emplace_back(r);
+    }
+
+    std::vector<F> evals = helper.final_evals();
+    for (const F& v: evals)
+    {
+        transcript.append_f(v);
+    }
+    return {rs, evals};
+}
+
+// Checks a proof of sumcheck_prove_virtual against combine(g_1(r), ..., g_k(r)).
+// Returns {verified, r, g(r)}, the values g_k(r) still have to be checked against the tables.
+template<typename F, typename F_primitive, typename Combine>
+std::tuple<bool, std::vector<F_primitive>, std::vector<F>> sumcheck_verify_virtual(
+    uint32 nb_vars,
+    uint32 nb_tables,
+    uint32 degree,
+    const F& claimed_sum,
+    const Combine& combine,
+    Proof<F>& proof,
+    Transcript<F, F_primitive>& transcript
+)
+{
+    F sum = claimed_sum;
+    std::vector<F_primitive> rs;
+    for (uint32 i_var = 0; i_var < nb_vars; i_var++)
+    {
+        std::vector<F> evals = read_round_message(proof, transcript, sum, degree);
+        F_primitive r = transcript.challenge_f();
+        sum = eval_from_evals(evals, r);
+        rs.emplace_back(r);
+    }
+
+    std::vector<F> evals(nb_tables);
+    for (uint32 k = 0; k < nb_tables; k++)
+    {
+        evals[k] = proof.get_next_and_step();
+        transcript.append_f(evals[k]);
+    }
+    return {combine(evals.data()) == sum, rs, evals};
+}
+
+}
@@ -0,0 +1,555 @@
+#pragma once
+
+#include "circuit/circuit.hpp"
+#include "configuration/config.hpp"
+#include "sumcheck_common.hpp"
+#include "sumcheck_verifier_utils.hpp"
+#include "sumcheck_virtual.hpp"
+#include "batch.hpp"
+
+namespace gkr
+{
+
+// Many witnesses of one circuit, beyond the lanes of F. Witness b of a layer with n input variables
+// sits at b 2^n + x, the batch index is made of the highest variables. A layer claim is proven as
+//  alpha v(rz1, rb) + beta v(rz2, rb) = \sum_b eq(rb, b) \sum_{x, y} (mul(rz, x, y) v(x, b) v(y, b) + add(rz, x) v(x, b) + pow(rz, x) v(x, b)^d)
+// in three sumchecks. Phase one binds x and phase two binds y, both summing over b inside their round
+// messages, so each reads the gates once for the whole batch. The last one binds b alone,
+//  \sum_b eq(rb, b) (M v(rx, b) v(ry, b) + A v(rx, b) + P v(rx, b)^d)
+// with M, A, P the wiring at (rz, rx, ry). The part of phase one phase two does not cover,
+// T = \sum_b eq(rb, b) (A v(rx, b) + P v(rx, b)^d), is sent in between. Only the last sumcheck checks T,
+// it proves S + lambda T for the value S left by phase two, with A and P weighted by lambda drawn after T.
+// The claims left on the next layer are v(rx, rb') and v(ry, rb') at the same batch point rb'.
+
+// Every layer of the circuit for all witnesses, filled by evaluate()
+template<typename F, typename F_primitive>
+class WitnessBatch
+{
+public:
+    using W = witness_field_t<F>;
+
+    uint32 nb_batch_vars;
+    // vals[i] is the input of layer i, vals.back() the output of the circuit
+    std::vector<std::vector<W>> vals;
+
+    uint32 nb_witnesses() const
+    {
+        return 1 << nb_batch_vars;
+    }
+
+    // The inputs of the circuit on the stacked layout, as committed
+    static std::vector<W> stack(const std::vector<std::vector<W>>& witnesses)
+    {
+        std::vector<W> stacked;
+        for (const std::vector<W>& witness: witnesses)
+        {
+            stacked.insert(stacked.end(), witness.begin(), witness.end());
+        }
+        return stacked;
+    }
+
+    // The circuit is left evaluated on the last witness
+    void evaluate(Circuit<F, F_primitive>& circuit, const std::vector<std::vector<W>>& witnesses)
+    {
+        assert(witnesses.size() == next_pow_of_2(witnesses.size()));
+        nb_batch_vars = __builtin_ctz(witnesses.size());
+        vals.assign(circuit.layers.size() + 1, {});
+        for (const std::vector<W>& witness: witnesses)
+        {
+            circuit.layers[0].input_layer_vals.evals = witness;
+            circuit.evaluate();
+            for (uint32 i = 0; i < circuit.layers.size(); i++)
+            {
+                const std::vector<W>& in = circuit.layers[i].input_layer_vals.evals;
+                assert(in.size() == (1u << circuit.layers[i].nb_input_vars));
+                vals[i].insert(vals[i].end(), in.begin(), in.end());
+            }
+            const std::vector<W>& out = circuit.layers.back().output_layer_vals.evals;
+            vals.back().insert(vals.back().end(), out.begin(), out.end());
+        }
+    }
+};
+
+// v h + p v^d over x, h holds the gates of phase one and p the power gates
+template<typename F>
+struct BatchPhaseOneCombine
+{
+    bool with_pow;
+    uint32 pow_degree;
+
+    F operator()(const F* g) const
+    {
+        F v = g[0] * g[1];
+        if (with_pow)
+        {
+            v += g[2] * pow_small(g[0], pow_degree);
+        }
+        return v;
+    }
+};
+
+// eq(rb, b) (M v(rx, b) v(ry, b) + A v(rx, b) + P v(rx, b)^d), reading eq, v(rx, .) and v(ry, .)
+template<typename F, typename F_primitive>
+struct BatchCombine
+{
+    F_primitive mul_at, add_at, pow_at;
+    bool with_mul, with_pow;
+    uint32 pow_degree;
+
+    F operator()(const F* g) const
+    {
+        F v = g[1] * add_at;
+        if (with_mul)
+        {
+            v += g[1] * g[2] * mul_at;
+        }
+        if (with_pow)
+        {
+            v += pow_small(g[1], pow_degree) * pow_at;
+        }
+        return g[0] * v;
+    }
+
+    uint32 degree() const
+    {
+        return std::max(with_mul ? 3u : 2u, with_pow ? pow_degree + 1 : 0u);
+    }
+};
+
+// alpha eq(rz1, z) + beta eq(rz2, z) over the outputs z of the layer
+template<typename F_primitive>
+std::vector<F_primitive> _batch_eq_z(uint32 nb_output_vars, const std::vector<F_primitive>& rz1, const std::vector<F_primitive>& rz2,
+    const F_primitive& alpha, const F_primitive& beta)
+{
+    std::vector<F_primitive> eq_z(1 << nb_output_vars), eq_z2(1 << nb_output_vars);
+    _eq_evals_at_primitive(rz1, alpha, eq_z.data());
+    _eq_evals_at_primitive(rz2, beta, eq_z2.data());
+    for (uint32 o = 0; o < eq_z.size(); o++)
+    {
+        eq_z[o] += eq_z2[o];
+    }
+    return eq_z;
+}
+
+// The tables of phase one besides v, h(x, b) = eq(rb, b) (\sum_y mul(rz, x, y) v(y, b) + add(rz, x)) and,
+// for layers with power gates, p(x, b) = eq(rb, b) pow(rz, x)
+template<typename F, typename F_primitive>
+std::tuple<std::vector<F>, std::vector<F>> _batch_phase_one_tables(
+    const CircuitLayer<F, F_primitive>& poly,
+    const std::vector<F>& v,
+    const std::vector<F_primitive>& eq_z,
+    const std::vector<F_primitive>& eq_b,
+    ThreadPool* pool = nullptr
+)
+{
+    uint32 size = 1 << poly.nb_input_vars;
+    uint32 nb_batch = eq_b.size();
+
+    // the rows of a type hold distinct x and the types are accumulated one after the other
+    std::vector<F> h(size * nb_batch, F::zero());
+    for (uint32 t = 0; t < nb_coef_types; t++)
+    {
+        const GateCSR<F_primitive>& mul = poly.mul.by_input[0][t];
+        parallel_for(pool, mul.nb_rows(), [&](uint32 thread_id, uint32 begin, uint32 end)
+        {
+            for (uint32 row = begin; row < end; row++)
+            {
+                uint32 x = mul.row_ids[row];
+                for (uint32 i = mul.row_starts[row]; i < mul.row_starts[row + 1]; i++)
+                {
+                    F_primitive w = eq_z[mul.o_ids[i]] * mul.coefs[i];
+                    uint32 y = mul.other_ids[i];
+                    for (uint32 b = 0; b < nb_batch; b++)
+                    {
+                        h[b * size + x] += v[b * size + y] * w;
+                    }
+                }
+            }
+        });
+    }
+    std::vector<F_primitive> add_w(size, F_primitive::zero()), pow_w(size, F_primitive::zero());
+    for (const auto& gate: poly.add.sparse_evals)
+    {
+        add_w[gate.i_ids[0]] += eq_z[gate.o_id] * gate.coef;
+    }
+    for (const auto& gate: poly.pow.sparse_evals)
+    {
+        pow_w[gate.i_ids[0]] += eq_z[gate.o_id] * gate.coef;
+    }
+    std::vector<F> p(poly.has_pow() ? size * nb_batch : 0);
+    for (uint32 b = 0; b < nb_batch; b++)
+    {
+        for (uint32 x = 0; x < size; x++)
+        {
+            h[b * size + x] = (h[b * size + x] + add_w[x]) * eq_b[b];
+            if (poly.has_pow())
+            {
+                p[b * size + x] = F::zero() + pow_w[x] * eq_b[b];
+            }
+        }
+    }
+    return {h, p};
+}
+
+// The table of phase two besides v, g(y, b) = eq(rb, b) v(rx, b) \sum_x mul(rz, x, y) eq(rx, x)
+template<typename F, typename F_primitive>
+std::vector<F> _batch_phase_two_table(
+    const CircuitLayer<F, F_primitive>& poly,
+    const std::vector<F>& vx,
+    const std::vector<F_primitive>& rx,
+    const std::vector<F_primitive>& eq_z,
+    const std::vector<F_primitive>& eq_b,
+    ThreadPool* pool = nullptr
+)
+{
+    uint32 size = 1 << poly.nb_input_vars;
+    uint32 nb_batch = eq_b.size();
+
+    std::vector<F_primitive> eq_x(size);
+    _eq_evals_at_primitive(rx, F_primitive::one(), eq_x.data());
+    std::vector<F_primitive> h_y(size, F_primitive::zero());
+    for (uint32 t = 0; t < nb_coef_types; t++)
+    {
+        const GateCSR<F_primitive>& mul = poly.mul.by_input[1][t];
+        parallel_for(pool, mul.nb_rows(), [&](uint32 thread_id, uint32 begin, uint32 end)
+        {
+            for (uint32 row = begin; row < end; row++)
+            {
+                F_primitive acc = F_primitive::zero();
+                for (uint32 i = mul.row_starts[row]; i < mul.row_starts[row + 1]; i++)
+                {
+                    acc += eq_z[mul.o_ids[i]] * eq_x[mul.other_ids[i]] * mul.coefs[i];
+                }
+                h_y[mul.row_ids[row]] += acc;
+            }
+        });
+    }
+    std::vector<F> g(size * nb_batch);
+    for (uint32 b = 0; b < nb_batch; b++)
+    {
+        F c = vx[b] * eq_b[b];
+        for (uint32 y = 0; y < size; y++)
+        {
+            g[b * size + y] = c * h_y[y];
+        }
+    }
+    return g;
+}
+
+// One repetition of a layer, vals holds its inputs for all witnesses. Returns {rx, ry, rb'}, ry = rx for linear layers.
+template<typename F, typename F_primitive>
+std::tuple<std::vector<F_primitive>, std::vector<F_primitive>, std::vector<F_primitive>> sumcheck_prove_gkr_layer_batch(
+    const CircuitLayer<F, F_primitive>& poly,
+    const std::vector<witness_field_t<F>>& vals,
+    uint32 nb_batch_vars,
+    const std::vector<F_primitive>& rz1,
+    const std::vector<F_primitive>& rz2,
+    const std::vector<F_primitive>& rb,
+    const F_primitive& alpha,
+    const F_primitive& beta,
+    Transcript<F, F_primitive>& transcript,
+    ThreadPool* pool = nullptr
+)
+{
+    uint32 nb_vars = poly.nb_input_vars;
+    uint32 nb_batch = 1 << nb_batch_vars;
+    // the tables of the virtual sumchecks are in F
+    std::vector<F> lifted;
+    const std::vector<F>& v = lift_table(vals, lifted);
+
+    std::vector<F_primitive> eq_z = _batch_eq_z(poly.nb_output_vars, rz1, rz2, alpha, beta);
+    std::vector<F_primitive> eq_b(nb_batch);
+    _eq_evals_at_primitive(rb, F_primitive::one(), eq_b.data());
+
+    auto [h, p] = _batch_phase_one_tables(poly, v, eq_z, eq_b, pool);
+    BatchPhaseOneCombine<F> x_combine{poly.has_pow(), poly.pow_degree};
+    SumcheckVirtualPolyHelper<F, F_primitive> x_helper;
+    std::vector<const F*> x_tables = {v.data(), h.data()};
+    if (poly.has_pow())
+    {
+        x_tables.emplace_back(p.data());
+    }
+    x_helper.prepare(x_tables, nb_vars + nb_batch_vars, poly.phase_one_degree(), pool);
+    std::vector<F_primitive> rx;
+    for (uint32 i_var = 0; i_var < nb_vars; i_var++)
+    {
+        append_round_message(transcript, x_helper.poly_eval_at(i_var, x_combine));
+        F_primitive r = transcript.challenge_f();
+        x_helper.receive_challenge(i_var, r, x_combine);
+        rx.emplace_back(r);
+    }
+    // v(rx, b)
+    std::vector<F> vx = x_helper.tables[0];
+
+    BatchCombine<F, F_primitive> combine{F_primitive::zero(), F_primitive::zero(), F_primitive::zero(), !poly.is_linear(), poly.has_pow(), poly.pow_degree};
+    combine.add_at = eval_sparse_circuit_connect_poly<F, F_primitive, 1>(poly.add, rz1, rz2, alpha, beta, {rx});
+    if (poly.has_pow())
+    {
+        combine.pow_at = eval_sparse_circuit_connect_poly<F, F_primitive, 1>(poly.pow, rz1, rz2, alpha, beta, {rx});
+    }
+    F rest = F::zero();
+    for (uint32 b = 0; b < nb_batch; b++)
+    {
+        rest += combine(std::vector<F>{F::zero() + eq_b[b], vx[b], F::zero()}.data());
+    }
+    transcript.append_f(rest);
+    // the last sumcheck covers rest with a random weight
+    F_primitive lambda = transcript.challenge_f();
+    combine.add_at *= lambda;
+    combine.pow_at *= lambda;
+
+    std::vector<F> e(nb_batch);
+    for (uint32 b = 0; b < nb_batch; b++)
+    {
+        e[b] = F::zero() + eq_b[b];
+    }
+    std::vector<const F*> b_tables = {e.data(), vx.data()};
+    std::vector<F_primitive> ry = rx;
+    std::vector<F> vy;
+    if (!poly.is_linear())
+    {
+        std::vector<F> g = _batch_phase_two_table(poly, vx, rx, eq_z, eq_b, pool);
+        SumcheckVirtualPolyHelper<F, F_primitive> y_helper;
+        y_helper.prepare({v.data(), g.data()}, nb_vars + nb_batch_vars, 2, pool);
+        ry.clear();
+        for (uint32 i_var = 0; i_var < nb_vars; i_var++)
+        {
+            append_round_message(transcript, y_helper.poly_eval_at(i_var, ProductCombine<F>{}));
+            F_primitive r = transcript.challenge_f();
+            y_helper.receive_challenge(i_var, r, ProductCombine<F>{});
+            ry.emplace_back(r);
+        }
+        vy = y_helper.tables[0];
+        b_tables.emplace_back(vy.data());
+        combine.mul_at = eval_sparse_circuit_connect_poly<F, F_primitive, 2>(poly.mul, rz1, rz2, alpha, beta, {rx, ry});
+    }
+
+    auto rb_next = std::get<0>(sumcheck_prove_virtual<F, F_primitive>(b_tables, nb_batch_vars, combine.degree(), combine, transcript, pool));
+    return {rx, ry, rb_next};
+}
+
+// Checks one repetition of sumcheck_prove_gkr_layer_batch.
+// Returns {verified, rx, ry, rb', v(rx, rb'), v(ry, rb')}, ry = rx for linear layers.
+template<typename F, typename F_primitive>
+std::tuple<bool, std::vector<F_primitive>, std::vector<F_primitive>, std::vector<F_primitive>, F, F> sumcheck_verify_gkr_layer_batch(
+    const CircuitLayer<F, F_primitive>& poly,
+    uint32 nb_batch_vars,
+    const std::vector<F_primitive>& rz1,
+    const std::vector<F_primitive>& rz2,
+    const std::vector<F_primitive>& rb,
+    const F& claimed_v1,
+    const F& claimed_v2,
+    const F_primitive& alpha,
+    const F_primitive& beta,
+    Proof<F>& proof,
+    Transcript<F, F_primitive>& transcript
+)
+{
+    uint32 nb_vars = poly.nb_input_vars;
+    F sum = claimed_v1 * alpha + claimed_v2 * beta;
+    // the constants are not summed over by the prover, their part of the claim is known
+    if (!poly.cst.empty())
+    {
+        sum = sum + -eval_sparse_const_poly(poly.cst, rz1, rz2, alpha, beta);
+    }
+
+    std::vector<F_primitive> rx;
+    for (uint32 i_var = 0; i_var < nb_vars; i_var++)
+    {
+        std::vector<F> evals = read_round_message(proof, transcript, sum, poly.phase_one_degree());
+        F_primitive r = transcript.challenge_f();
+        sum = eval_from_evals(evals, r);
+        rx.emplace_back(r);
+    }
+    F rest = proof.get_next_and_step();
+    transcript.append_f(rest);
+    F_primitive lambda = transcript.challenge_f();
+
+    BatchCombine<F, F_primitive> combine{F_primitive::zero(), F_primitive::zero(), F_primitive::zero(), !poly.is_linear(), poly.has_pow(), poly.pow_degree};
+    combine.add_at = eval_sparse_circuit_connect_poly<F, F_primitive, 1>(poly.add, rz1, rz2, alpha, beta, {rx});
+    if (poly.has_pow())
+    {
+        combine.pow_at = eval_sparse_circuit_connect_poly<F, F_primitive, 1>(poly.pow, rz1, rz2, alpha, beta, {rx});
+    }
+
+    combine.add_at *= lambda;
+    combine.pow_at *= lambda;
+
+    // phase two proves what phase one left apart from rest, nothing for linear layers
+    sum = sum - rest;
+    bool verified = true;
+    std::vector<F_primitive> ry = rx;
+    if (!poly.is_linear())
+    {
+        ry.clear();
+        for (uint32 i_var = 0; i_var < nb_vars; i_var++)
+        {
+            std::vector<F> evals = read_round_message(proof, transcript, sum);
+            F_primitive r = transcript.challenge_f();
+            sum = eval_from_evals(evals, r);
+            ry.emplace_back(r);
+        }
+        combine.mul_at = eval_sparse_circuit_connect_poly<F, F_primitive, 2>(poly.mul, rz1, rz2, alpha, beta, {rx, ry});
+    }
+    else
+    {
+        verified &= sum == F::zero();
+    }
+
+    // rest is only checked here, weighted by lambda drawn after it was sent
+    uint32 nb_tables = poly.is_linear() ? 2 : 3;
+    auto [b_verified, rb_next, evals] = sumcheck_verify_virtual<F, F_primitive>(nb_batch_vars, nb_tables, combine.degree(), sum + rest * lambda, combine, proof, transcript);
+    verified &= b_verified && evals[0] == F::zero() + _eq_at(rb, rb_next);
+    F vy = poly.is_linear() ? evals[1] : evals[2];
+    return {verified, rx, ry, rb_next, evals[1], vy};
+}
+
+// Returns the claimed outputs at (rz, rb) and the points rz1, rz2, rb of the claims left on the input layer.
+// The circuit has no lookup.
+template<typename F, typename F_primitive>
+std::tuple<std::vector<F>, std::vector<std::vector<F_primitive>>, std::vector<std::vector<F_primitive>>, std::vector<std::vector<F_primitive>>> gkr_prove_batch(
+    const Circuit<F, F_primitive>& circuit,
+    const WitnessBatch<F, F_primitive>& batch,
+    Transcript<F, F_primitive>& transcript,
+    const Config& config,
+    ThreadPool* pool = nullptr
+)
+{
+    uint32 nb_repetitions = config.get_num_repetitions();
+    std::vector<std::vector<F_primitive>> rz1(nb_repetitions), rz2(nb_repetitions), rb(nb_repetitions);
+    std::vector<F> claimed_v(nb_repetitions);
+    for (uint32 j = 0; j < nb_repetitions; j++)
+    {
+        rz1[j] = transcript.challenge_fs(circuit.layers.back().nb_output_vars);
+        rz2[j].assign(rz1[j].size(), F_primitive::zero());
+        rb[j] = transcript.challenge_fs(batch.nb_batch_vars);
+        std::vector<F_primitive> point = rz1[j];
+        point.insert(point.end(), rb[j].begin(), rb[j].end());
+        claimed_v[j] = eval_multilinear(batch.vals.back(), point);
+    }
+
+    F_primitive alpha = F_primitive::one(), beta = F_primitive::zero();
+    for (int i = circuit.layers.size() - 1; i >= 0; i--)
+    {
+        for (uint32 j = 0; j < nb_repetitions; j++)
+        {
+            std::tie(rz1[j], rz2[j], rb[j]) = sumcheck_prove_gkr_layer_batch(circuit.layers[i], batch.vals[i], batch.nb_batch_vars,
+                rz1[j], rz2[j], rb[j], alpha, beta, transcript, pool);
+        }
+        alpha = transcript.challenge_f();
+        beta = transcript.challenge_f();
+    }
+    return {claimed_v, rz1, rz2, rb};
+}
+
+// Returns {verified, rz1, rz2, rb, v(rz1, rb), v(rz2, rb)}, the claims left on the input layer.
+// The lookup of the circuit is not part of the batch, verified is false when it has one.
+template<typename F, typename F_primitive>
+std::tuple<bool, std::vector<std::vector<F_primitive>>, std::vector<std::vector<F_primitive>>, std::vector<std::vector<F_primitive>>,
+    std::vector<F>, std::vector<F>> gkr_verify_batch(
+    const Circuit<F, F_primitive>& circuit,
+    uint32 nb_batch_vars,
+    const std::vector<F>& claimed_v,
+    Transcript<F, F_primitive>& transcript,
+    Proof<F>& proof,
+    const Config& config
+)
+{
+    uint32 nb_repetitions = config.get_num_repetitions();
+    std::vector<std::vector<F_primitive>> rz1(nb_repetitions), rz2(nb_repetitions), rb(nb_repetitions);
+    for (uint32 j = 0; j < nb_repetitions; j++)
+    {
+        rz1[j] = transcript.challenge_fs(circuit.layers.back().nb_output_vars);
+        rz2[j].assign(rz1[j].size(), F_primitive::zero());
+        rb[j] = transcript.challenge_fs(nb_batch_vars);
+    }
+    std::vector<F> claimed_v1 = claimed_v, claimed_v2(nb_repetitions, F::zero());
+
+    bool verified = circuit.lookup.empty();
+    F_primitive alpha = F_primitive::one(), beta = F_primitive::zero();
+    for (int i = circuit.layers.size() - 1; i >= 0; i--)
+    {
+        for (uint32 j = 0; j < nb_repetitions; j++)
+        {
+            bool layer_verified;
+            std::tie(layer_verified, rz1[j], rz2[j], rb[j], claimed_v1[j], claimed_v2[j]) = sumcheck_verify_gkr_layer_batch(circuit.layers[i], nb_batch_vars,
+                rz1[j], rz2[j], rb[j], claimed_v1[j], claimed_v2[j], alpha, beta, proof, transcript);
+            verified &= layer_verified;
+        }
+        alpha = transcript.challenge_f();
+        beta = transcript.challenge_f();
+    }
+    return {verified, rz1, rz2, rb, claimed_v1, claimed_v2};
+}
+
+// (r, rb), the point of the stacked inputs
+template<typename F_primitive>
+std::vector<F_primitive> batch_point(const std::vector<F_primitive>& r, const std::vector<F_primitive>& rb)
+{
+    std::vector<F_primitive> point = r;
+    point.insert(point.end(), rb.begin(), rb.end());
+    return point;
+}
+
+// Reduces v(rz1, rb) and v(rz2, rb) to one claim on the stacked inputs per repetition, as sumcheck_prove_combine_claims.
+// Returns the points of these claims, their values are appended.
+template<typename F, typename F_primitive>
+std::vector<std::vector<F_primitive>> batch_prove_witness_claims(
+    const std::vector<F>& stacked,
+    const std::vector<std::vector<F_primitive>>& rz1,
+    const std::vector<std::vector<F_primitive>>& rz2,
+    const std::vector<std::vector<F_primitive>>& rb,
+    Transcript<F, F_primitive>& transcript,
+    const Config& config,
+    ThreadPool* pool = nullptr
+)
+{
+    uint32 nb_vars = __builtin_ctz(stacked.size());
+    std::vector<std::vector<F_primitive>> r(config.get_num_repetitions());
+    for (int j = 0; j < config.get_num_repetitions(); j++)
+    {
+        F_primitive a = transcript.challenge_f();
+        std::vector<F_primitive> eq_1(stacked.size()), eq_2(stacked.size());
+        _eq_evals_at_primitive(batch_point(rz1[j], rb[j]), F_primitive::one(), eq_1.data());
+        _eq_evals_at_primitive(batch_point(rz2[j], rb[j]), a, eq_2.data());
+        std::vector<F> eq_sum(stacked.size());
+        for (uint32 x = 0; x < stacked.size(); x++)
+        {
+            eq_sum[x] = F::zero() + (eq_1[x] + eq_2[x]);
+        }
+        r[j] = std::get<0>(sumcheck_prove_virtual<F, F_primitive>({stacked.data(), eq_sum.data()}, nb_vars, 2, ProductCombine<F>{}, transcript, pool));
+    }
+    return r;
+}
+
+// Checks a proof of batch_prove_witness_claims, returns {verified, r, v(r)}, v(r) is left to the opening
+template<typename F, typename F_primitive>
+std::tuple<bool, std::vector<std::vector<F_primitive>>, std::vector<F>> batch_verify_witness_claims(
+    uint32 nb_vars,
+    const std::vector<std::vector<F_primitive>>& rz1,
+    const std::vector<std::vector<F_primitive>>& rz2,
+    const std::vector<std::vector<F_primitive>>& rb,
+    const std::vector<F>& claimed_v1,
+    const std::vector<F>& claimed_v2,
+    Proof<F>& proof,
+    Transcript<F, F_primitive>& transcript,
+    const Config& config
+)
+{
+    bool verified = true;
+    std::vector<std::vector<F_primitive>> r(config.get_num_repetitions());
+    std::vector<F> v(config.get_num_repetitions());
+    for (int j = 0; j < config.get_num_repetitions(); j++)
+    {
+        F_primitive a = transcript.challenge_f();
+        auto [sumcheck_verified, r_j, evals] = sumcheck_verify_virtual<F, F_primitive>(nb_vars, 2, 2, claimed_v1[j] + claimed_v2[j] * a,
+            ProductCombine<F>{}, proof, transcript);
+        F_primitive eq_sum = _eq_at(batch_point(rz1[j], rb[j]), r_j) + a * _eq_at(batch_point(rz2[j], rb[j]), r_j);
+        verified &= sumcheck_verified && evals[1] == F::zero() + eq_sum;
+        r[j] = r_j;
+        v[j] = evals[0];
+    }
+    return {verified, r, v};
+}
+
+}
@@ -3,9 +3,12 @@
 #include "poly_commit/poly.hpp"
 #include "../utils/types.hpp"
 #include "../utils/myutil.hpp"
+#include "../field/basefield.hpp"
 #include "circuit_raw.hpp"
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <type_traits>
 
 namespace gkr
 {
@@ -29,6 +32,112 @@ public:
     }
 };
 
+// Almost all gates produced by the compilers have coefficient 1, the buckets below let the
+// gate loops skip the field multiplication for them and for -1
+enum class CoefType
+{
+    Unit,
+    NegUnit,
+    General,
+};
+const uint32 nb_coef_types = 3;
+
+template<typename F>
+CoefType coef_type_of(const F &coef)
+{
+    if (coef == F::one())
+    {
+        return CoefType::Unit;
+    }
+    if (coef == -F::one())
+    {
+        return CoefType::NegUnit;
+    }
+    return CoefType::General;
+}
+
+// v * coef for a coefficient known to be of type ct
+template<CoefType ct, typename T, typename F>
+inline T mul_coef(const T &v, const F &coef)
+{
+    if constexpr (ct == CoefType::Unit)
+    {
+        return v;
+    }
+    else if constexpr (ct == CoefType::NegUnit)
+    {
+        return -v;
+    }
+    else
+    {
+        return v * coef;
+    }
+}
+
+// coef as met by the values of a circuit over F, i.e. in witness_field_t<F>. When that field is
+// smaller than F the coefficients are read from base field circuit files and have no random ones,
+// see Circuit::supports_rand_coefs
+template<typename F, typename F_primitive>
+inline auto witness_coef(const F_primitive &coef)
+{
+    if constexpr (std::is_same_v<witness_field_t<F>, F>)
+    {
+        return coef;
+    }
+    else
+    {
+        return witness_part(coef);
+    }
+}
+
+// x^d by square and multiply, d is a small gate degree
+template<typename F>
+inline F pow_small(const F &x, uint32 d)
+{
+    F result = F::one();
+    F base = x;
+    for (; d > 0; d >>= 1)
+    {
+        if (d & 1)
+        {
+            result = result * base;
+        }
+        base = base * base;
+    }
+    return result;
+}
+
+// Calls kernel(std::integral_constant<CoefType, ct>{}) for each coefficient type,
+// the kernel reads the type back as a compile time constant
+template<typename Kernel>
+inline void for_each_coef_type(Kernel &&kernel)
+{
+    kernel(std::integral_constant<CoefType, CoefType::Unit>{});
+    kernel(std::integral_constant<CoefType, CoefType::NegUnit>{});
+    kernel(std::integral_constant<CoefType, CoefType::General>{});
+}
+
+// Gates grouped by one of their inputs, stored as structure of arrays.
+// Gates of row i are [row_starts[i], row_starts[i + 1]) and all read input row_ids[i],
+// so accumulating into the bookkeeping of that input is sequential and rows can be
+// split across threads without write conflicts.
+template<typename F>
+class GateCSR
+{
+public:
+    std::vector<uint32> row_ids;
+    std::vector<uint32> row_starts;
+    std::vector<uint32> o_ids;
+    // the remaining input of a mul gate, empty for add gates
+    std::vector<uint32> other_ids;
+    std::vector<F> coefs;
+
+    uint32 nb_rows() const
+    {
+        return row_ids.size();
+    }
+};
+
 template<typename F, uint32 nb_input>
 class SparseCircuitConnection
 {
@@ -37,6 +146,142 @@ public:
     uint32 nb_input_vars;
     std::vector<Gate<F, nb_input>> sparse_evals; 
 
+    // The last nb_rand_coefs gates take random coefficients drawn from the transcript once the input
+    // is committed, see set_rand_coefs. They are general gates, so compile() leaves them last.
+    uint32 nb_rand_coefs = 0;
+
+    // filled by compile(): sparse_evals is partitioned by coefficient type, the gates of type t are
+    // [coef_type_starts[t], coef_type_starts[t + 1]), and by_input[i][t] groups them by i_ids[i].
+    // Gates added, removed or given other coefficients are only seen once compile() runs again
+    uint32 coef_type_starts[nb_coef_types + 1] = {};
+    GateCSR<F> by_input[nb_input][nb_coef_types];
+    // position of random gate r in by_input[i][General] at rand_coef_pos[i][r]
+    std::vector<uint32> rand_coef_pos[nb_input];
+
+    // The layouts cover every gate, i.e. compile() ran since the last gate was added or removed
+    bool is_compiled() const
+    {
+        return coef_type_starts[nb_coef_types] == sparse_evals.size();
+    }
+
+    template<CoefType ct>
+    const Gate<F, nb_input>* gates_begin() const
+    {
+        assert(is_compiled());
+        return sparse_evals.data() + coef_type_starts[static_cast<uint32>(ct)];
+    }
+
+    template<CoefType ct>
+    const Gate<F, nb_input>* gates_end() const
+    {
+        assert(is_compiled());
+        return sparse_evals.data() + coef_type_starts[static_cast<uint32>(ct) + 1];
+    }
+
+    template<CoefType ct>
+    const GateCSR<F>& csr(uint32 input_idx) const
+    {
+        assert(is_compiled());
+        return by_input[input_idx][static_cast<uint32>(ct)];
+    }
+
+    // Stable partition of the gates by coefficient type, then the grouped layouts,
+    // to be called once the gate list is final. The random gates stay general whatever their coefficient.
+    void compile()
+    {
+        coef_type_starts[0] = 0;
+        auto it = sparse_evals.begin();
+        auto rand_it = sparse_evals.end() - nb_rand_coefs;
+        for (uint32 t = 0; t < nb_coef_types; t++)
+        {
+            it = std::stable_partition(it, rand_it, [t](const Gate<F, nb_input> &gate)
+            {
+                return static_cast<uint32>(coef_type_of(gate.coef)) == t;
+            });
+            coef_type_starts[t + 1] = it - sparse_evals.begin();
+        }
+        static_assert(static_cast<uint32>(CoefType::General) == nb_coef_types - 1);
+        coef_type_starts[nb_coef_types] = sparse_evals.size();
+
+        const Gate<F, nb_input>* rand_begin = sparse_evals.data() + sparse_evals.size() - nb_rand_coefs;
+        for (uint32 k = 0; k < nb_input; k++)
+        {
+            rand_coef_pos[k].resize(nb_rand_coefs);
+            for (uint32 t = 0; t < nb_coef_types; t++)
+            {
+                _compile_csr(k, sparse_evals.data() + coef_type_starts[t], sparse_evals.data() + coef_type_starts[t + 1], by_input[k][t],
+                    rand_begin, rand_coef_pos[k].data());
+            }
+        }
+    }
+
+    // Gives the random gates their coefficients, in the gate list and in the grouped layouts
+    void set_rand_coefs(const F* coefs)
+    {
+        Gate<F, nb_input>* rand_gates = sparse_evals.data() + sparse_evals.size() - nb_rand_coefs;
+        for (uint32 r = 0; r < nb_rand_coefs; r++)
+        {
+            rand_gates[r].coef = coefs[r];
+        }
+        for (uint32 k = 0; k < nb_input; k++)
+        {
+            F* csr_coefs = by_input[k][static_cast<uint32>(CoefType::General)].coefs.data();
+            for (uint32 r = 0; r < nb_rand_coefs; r++)
+            {
+                csr_coefs[rand_coef_pos[k][r]] = coefs[r];
+            }
+        }
+    }
+
+    // counting sort of [begin, end) by i_ids[k], the position of a gate from rand_begin on is
+    // written to rand_pos[gate - rand_begin]
+    static void _compile_csr(uint32 k, const Gate<F, nb_input>* begin, const Gate<F, nb_input>* end, GateCSR<F> &csr,
+        const Gate<F, nb_input>* rand_begin, uint32* rand_pos)
+    {
+        uint32 nb_gates = end - begin;
+        uint32 max_id = 0;
+        for (const Gate<F, nb_input> *gate = begin; gate != end; gate++)
+        {
+            max_id = std::max(max_id, gate->i_ids[k]);
+        }
+        std::vector<uint32> offsets(nb_gates > 0 ? max_id + 2 : 1, 0);
+        for (const Gate<F, nb_input> *gate = begin; gate != end; gate++)
+        {
+            offsets[gate->i_ids[k] + 1]++;
+        }
+
+        csr.row_ids.clear();
+        csr.row_starts.clear();
+        for (uint32 id = 0; id + 1 < offsets.size(); id++)
+        {
+            if (offsets[id + 1] > 0)
+            {
+                csr.row_ids.emplace_back(id);
+                csr.row_starts.emplace_back(offsets[id]);
+            }
+            offsets[id + 1] += offsets[id];
+        }
+        csr.row_starts.emplace_back(nb_gates);
+
+        csr.o_ids.resize(nb_gates);
+        csr.other_ids.resize(nb_input > 1 ? nb_gates : 0);
+        csr.coefs.resize(nb_gates);
+        for (const Gate<F, nb_input> *gate = begin; gate != end; gate++)
+        {
+            uint32 pos = offsets[gate->i_ids[k]]++;
+            if (gate >= rand_begin)
+            {
+                rand_pos[gate - rand_begin] = pos;
+            }
+            csr.o_ids[pos] = gate->o_id;
+            if (nb_input > 1)
+            {
+                csr.other_ids[pos] = gate->i_ids[nb_input - 1 - k];
+            }
+            csr.coefs[pos] = gate->coef;
+        }
+    }
+
     static SparseCircuitConnection random(uint32 nb_output_vars, uint32 nb_input_vars)
     {
         SparseCircuitConnection poly;
@@ -65,45 +310,228 @@ public:
     }
 };
 
+// out[o_id] += coef, a constant term of an output
+template<typename F>
+class ConstGate
+{
+public:
+    uint32 o_id;
+    F coef;
+};
+
+// Constant terms read no input, so they never enter the sumcheck: the verifier subtracts their
+// MLE at the output claim, see eval_sparse_const_poly
+template<typename F>
+class ConstConnection
+{
+public:
+    std::vector<ConstGate<F>> sparse_evals;
+    // the last nb_rand_coefs constants are drawn from the transcript, as for SparseCircuitConnection
+    uint32 nb_rand_coefs = 0;
+
+    bool empty() const
+    {
+        return sparse_evals.empty();
+    }
+
+    void set_rand_coefs(const F* coefs)
+    {
+        ConstGate<F>* rand_gates = sparse_evals.data() + sparse_evals.size() - nb_rand_coefs;
+        for (uint32 r = 0; r < nb_rand_coefs; r++)
+        {
+            rand_gates[r].coef = coefs[r];
+        }
+    }
+};
+
 template<typename F, typename F_primitive>
 class CircuitLayer
 {
 public: 
+    // the values, the extension F only holds the challenges and the folded tables of the prover
+    using W = witness_field_t<F>;
+
     uint32 nb_output_vars;
     uint32 nb_input_vars;
-    MultiLinearPoly<F> input_layer_vals;
-    MultiLinearPoly<F> output_layer_vals;
+    MultiLinearPoly<W> input_layer_vals;
+    MultiLinearPoly<W> output_layer_vals;
 
     SparseCircuitConnection<F_primitive, 1> add;
     SparseCircuitConnection<F_primitive, 2> mul;
+    // out[o] += coef * in[i]^pow_degree, e.g. the x^5 S-box of Poseidon or MiMC in a single layer.
+    // They only involve x, so they raise the degree of the phase one round polynomials to pow_degree + 1
+    SparseCircuitConnection<F_primitive, 1> pow;
+    uint32 pow_degree = 5;
+    // out[o] += coef, the constants of the circuit without an input wire carrying them
+    ConstConnection<F_primitive> cst;
+
+    // bitsets over the inputs, x of any gate for phase one and y of the mul gates for phase two.
+    // The sumcheck skips the entries outside of them, filled by compile()
+    std::vector<uint64> phase_one_gate_mask;
+    std::vector<uint64> phase_two_gate_mask;
+    // the same sets as sorted lists, walked instead of the bitsets when they are sparse
+    std::vector<uint32> phase_one_gate_ids;
+    std::vector<uint32> phase_two_gate_ids;
+
+    // Every lane of every input is 0 or 1, the sumcheck then runs its first rounds with selects.
+    // Set by detect_bit_input(), which Circuit::evaluate() runs on every layer
+    bool input_is_bits = false;
+
+    // Outputs past nb_active_outputs have no gate and are zero. Inputs past nb_active_inputs are
+    // known to be zero, the sumcheck never folds them. Both are set by compile(), which assumes
+    // every input may be nonzero, and the inputs are narrowed by Circuit::evaluate()
+    uint32 nb_active_outputs;
+    uint32 nb_active_inputs;
 
     static CircuitLayer random(uint32 nb_output_vars, uint32 nb_input_vars)
     {
         CircuitLayer poly;
         poly.nb_output_vars = nb_output_vars;
         poly.nb_input_vars = nb_input_vars;
-        poly.input_layer_vals = MultiLinearPoly<F>::random(nb_input_vars);
+        poly.input_layer_vals = MultiLinearPoly<W>::random(nb_input_vars);
 
         poly.mul = SparseCircuitConnection<F_primitive, 2>::random(nb_output_vars, nb_input_vars);
         poly.add = SparseCircuitConnection<F_primitive, 1>::random(nb_output_vars, nb_input_vars); 
+        poly.compile();
         return poly;
     }
 
-    std::vector<F> evaluate() const
+    void detect_bit_input()
+    {
+        input_is_bits = std::all_of(input_layer_vals.evals.begin(), input_layer_vals.evals.end(), [](const W& v) { return is_bit(v); });
+    }
+
+    // Layers without mul gates only need the phase one sumcheck, see sumcheck_prove_gkr_layer
+    bool is_linear() const
     {
-        std::vector<F> output(1 << nb_output_vars, F::zero());
-        for (const Gate<F_primitive, 2>& gate: mul.sparse_evals)
+        return mul.sparse_evals.empty();
+    }
+
+    bool has_pow() const
+    {
+        return !pow.sparse_evals.empty();
+    }
+
+    // Degree of the round polynomials of phase one, phase two stays at 2
+    uint32 phase_one_degree() const
+    {
+        return has_pow() ? pow_degree + 1 : 2;
+    }
+
+    std::vector<W> evaluate() const
+    {
+        // outputs are reduced once, after all of their gates are in
+        std::vector<Accumulator<W>> acc(1 << nb_output_vars);
+        const std::vector<W>& in = input_layer_vals.evals;
+        for_each_coef_type([&](auto coef_type)
+        {
+            constexpr CoefType ct = decltype(coef_type)::value;
+            for (auto gate = mul.template gates_begin<ct>(); gate != mul.template gates_end<ct>(); gate++)
+            {
+                if constexpr (ct == CoefType::Unit)
+                {
+                    acc[gate->o_id].mul_add(in[gate->i_ids[0]], in[gate->i_ids[1]]);
+                }
+                else if constexpr (ct == CoefType::NegUnit)
+                {
+                    acc[gate->o_id].mul_add(in[gate->i_ids[0]], -in[gate->i_ids[1]]);
+                }
+                else
+                {
+                    acc[gate->o_id].mul_add(in[gate->i_ids[0]] * in[gate->i_ids[1]], witness_coef<F>(gate->coef));
+                }
+            }
+
+            for (auto gate = add.template gates_begin<ct>(); gate != add.template gates_end<ct>(); gate++)
+            {
+                if constexpr (ct == CoefType::General)
+                {
+                    acc[gate->o_id].mul_add(in[gate->i_ids[0]], witness_coef<F>(gate->coef));
+                }
+                else
+                {
+                    acc[gate->o_id].add(mul_coef<ct>(in[gate->i_ids[0]], witness_coef<F>(gate->coef)));
+                }
+            }
+        });
+
+        for (const auto& gate: pow.sparse_evals)
         {
-            output[gate.o_id] += input_layer_vals.evals[gate.i_ids[0]] * input_layer_vals.evals[gate.i_ids[1]] * gate.coef;
+            acc[gate.o_id].mul_add(pow_small(in[gate.i_ids[0]], pow_degree), witness_coef<F>(gate.coef));
         }
 
-        for (const Gate<F_primitive, 1>& gate: add.sparse_evals)
+        for (const auto& gate: cst.sparse_evals)
         {
-            output[gate.o_id] += input_layer_vals.evals[gate.i_ids[0]] * gate.coef;
+            acc[gate.o_id].add(W::zero() + witness_coef<F>(gate.coef));
+        }
+
+        std::vector<W> output(acc.size());
+        for (uint32 i = 0; i < acc.size(); i++)
+        {
+            output[i] = acc[i].result();
         }
         return output;
     }
 
+    void compile()
+    {
+        mul.compile();
+        add.compile();
+        pow.compile();
+
+        uint32 input_size = 1 << nb_input_vars;
+        for (uint32 t = 0; t < nb_coef_types; t++)
+        {
+            // row ids are sorted, the last one is the largest input id
+            for (const GateCSR<F_primitive>* csr: {&mul.by_input[0][t], &mul.by_input[1][t], &add.by_input[0][t], &pow.by_input[0][t]})
+            {
+                if (csr->nb_rows() > 0)
+                {
+                    input_size = std::max(input_size, csr->row_ids.back() + 1);
+                }
+            }
+        }
+        uint32 nb_words = bitset_nb_words(input_size);
+        phase_one_gate_mask.assign(nb_words, 0);
+        phase_two_gate_mask.assign(nb_words, 0);
+        for (uint32 t = 0; t < nb_coef_types; t++)
+        {
+            for (uint32 x: mul.by_input[0][t].row_ids)
+            {
+                bitset_set(phase_one_gate_mask.data(), x);
+            }
+            for (uint32 x: add.by_input[0][t].row_ids)
+            {
+                bitset_set(phase_one_gate_mask.data(), x);
+            }
+            for (uint32 y: mul.by_input[1][t].row_ids)
+            {
+                bitset_set(phase_two_gate_mask.data(), y);
+            }
+        }
+        phase_one_gate_ids = bitset_to_ids(phase_one_gate_mask);
+        phase_two_gate_ids = bitset_to_ids(phase_two_gate_mask);
+
+        nb_active_outputs = 1;
+        for (const auto& gate: mul.sparse_evals)
+        {
+            nb_active_outputs = std::max(nb_active_outputs, gate.o_id + 1);
+        }
+        for (const auto& gate: add.sparse_evals)
+        {
+            nb_active_outputs = std::max(nb_active_outputs, gate.o_id + 1);
+        }
+        for (const auto& gate: pow.sparse_evals)
+        {
+            nb_active_outputs = std::max(nb_active_outputs, gate.o_id + 1);
+        }
+        for (const auto& gate: cst.sparse_evals)
+        {
+            nb_active_outputs = std::max(nb_active_outputs, gate.o_id + 1);
+        }
+        nb_active_inputs = 1 << nb_input_vars;
+    }
+
     uint32 nb_mul_gates() const
     {
         return mul.sparse_evals.size();
@@ -115,11 +543,43 @@ public:
     }
 };
 
+// A public table every value of the input layer, in every lane, must belong to, e.g. the
+// limbs of a range check or of a Keccak bit decomposition. Proven with LogUp next to the layers,
+// see logup.hpp. The size is a power of two, no values means no lookup.
+template<typename F_primitive>
+class LookupTable
+{
+public:
+    std::vector<F_primitive> values;
+
+    bool empty() const
+    {
+        return values.empty();
+    }
+
+    uint32 nb_vars() const
+    {
+        return __builtin_ctz(values.size());
+    }
+
+    // 0, ..., 2^nb_bits - 1
+    static LookupTable range(uint32 nb_bits)
+    {
+        LookupTable table;
+        for (uint32 i = 0; i < (1u << nb_bits); i++)
+        {
+            table.values.emplace_back(F_primitive(i));
+        }
+        return table;
+    }
+};
+
 template<typename F, typename F_primitive>
 class Circuit
 {
 public:
     std::vector<CircuitLayer<F, F_primitive>> layers;
+    LookupTable<F_primitive> lookup;
 
     void _compute_nb_vars()
     {
@@ -135,19 +595,35 @@ public:
                 max_i_gate_id = std::max({max_i_gate_id, gate.i_ids[0], gate.i_ids[1]});
             }
 
-            for (size_t j = 0; j < layer.add.sparse_evals.size(); j++)
+            for (const auto* gates: {&layer.add.sparse_evals, &layer.pow.sparse_evals})
+            {
+                for (const Gate<F_primitive, 1> &gate: *gates)
+                {
+                    max_o_gate_id = std::max(max_o_gate_id, gate.o_id);
+                    max_i_gate_id = std::max(max_i_gate_id, gate.i_ids[0]);
+                }
+            }
+
+            for (const ConstGate<F_primitive> &gate: layer.cst.sparse_evals)
             {
-                const Gate<F_primitive, 1> &gate = layer.add.sparse_evals[j];
                 max_o_gate_id = std::max(max_o_gate_id, gate.o_id);
-                max_i_gate_id = std::max(max_i_gate_id, gate.i_ids[0]);
             }
 
-            layer.nb_input_vars = max_i_gate_id > 0 ? __builtin_ctz(next_pow_of_2(max_i_gate_id)) : 0;
-            layer.nb_output_vars = max_o_gate_id > 0 ? __builtin_ctz(next_pow_of_2(max_o_gate_id)) : 0;
+            // ids [0, max_id] need max_id + 1 entries
+            layer.nb_input_vars = __builtin_ctz(next_pow_of_2(max_i_gate_id + 1));
+            layer.nb_output_vars = __builtin_ctz(next_pow_of_2(max_o_gate_id + 1));
             layer.input_layer_vals.nb_vars = layer.nb_input_vars;
         }
     }
 
+    void compile()
+    {
+        for (CircuitLayer<F, F_primitive> &layer: layers)
+        {
+            layer.compile();
+        }
+    }
+
     //TODO: Keep an eye on rounding up the number of gates, efficiency & security
     static Circuit load_extracted_gates(const char *filename_mul, const char *filename_add)
     {
@@ -211,6 +687,7 @@ public:
         fclose(file);
         
         c._compute_nb_vars();
+        c.compile();
         return c;
     }
 
@@ -226,6 +703,8 @@ public:
             
             const auto &layer_raw = circuit_raw.layer_at(i);
             const auto leaves = layer_raw.scan_leaf_segments(circuit_raw, circuit_raw.layers[i]);
+            // gates carrying the sentinel go last, their coefficients come from the transcript
+            std::vector<Gate<F_primitive, 2>> rand_muls;
             for (const auto &gate_mul_raw : layer_raw.leaf_gate_muls(circuit_raw, leaves))
             {
                 Gate<F_primitive, 2> gate_mul;
@@ -233,23 +712,77 @@ public:
                 gate_mul.i_ids[0] = gate_mul_raw.in0;
                 gate_mul.i_ids[1] = gate_mul_raw.in1;
                 gate_mul.coef = gate_mul_raw.coef;
-                layer.mul.sparse_evals.emplace_back(gate_mul);
+                (gate_mul_raw.coef == Segment<F_primitive>::current_rand_sentinel ? rand_muls : layer.mul.sparse_evals).emplace_back(gate_mul);
             }
+            layer.mul.sparse_evals.insert(layer.mul.sparse_evals.end(), rand_muls.begin(), rand_muls.end());
+            layer.mul.nb_rand_coefs = rand_muls.size();
 
+            std::vector<Gate<F_primitive, 1>> rand_adds;
             for (const auto &gate_add_raw : layer_raw.leaf_gate_adds(circuit_raw, leaves))
             {
                 Gate<F_primitive, 1> gate_add;
                 gate_add.o_id = gate_add_raw.out;
                 gate_add.i_ids[0] = gate_add_raw.in0;
                 gate_add.coef = gate_add_raw.coef;
-                layer.add.sparse_evals.emplace_back(gate_add);
+                (gate_add_raw.coef == Segment<F_primitive>::current_rand_sentinel ? rand_adds : layer.add.sparse_evals).emplace_back(gate_add);
+            }
+            layer.add.sparse_evals.insert(layer.add.sparse_evals.end(), rand_adds.begin(), rand_adds.end());
+            layer.add.nb_rand_coefs = rand_adds.size();
+
+            std::vector<ConstGate<F_primitive>> rand_csts;
+            for (const auto &gate_const_raw : layer_raw.leaf_gate_consts(circuit_raw, leaves))
+            {
+                ConstGate<F_primitive> gate_const{static_cast<uint32>(gate_const_raw.out), gate_const_raw.coef};
+                (gate_const_raw.coef == Segment<F_primitive>::current_rand_sentinel ? rand_csts : layer.cst.sparse_evals).emplace_back(gate_const);
             }
+            layer.cst.sparse_evals.insert(layer.cst.sparse_evals.end(), rand_csts.begin(), rand_csts.end());
+            layer.cst.nb_rand_coefs = rand_csts.size();
         }
 
         circuit._compute_nb_vars();
+        circuit.compile();
         return circuit;
     }
 
+    uint32 nb_rand_coefs() const
+    {
+        uint32 sum = 0;
+        for (const CircuitLayer<F, F_primitive>& layer: layers)
+        {
+            sum += layer.mul.nb_rand_coefs + layer.add.nb_rand_coefs + layer.cst.nb_rand_coefs;
+        }
+        return sum;
+    }
+
+    // Random coefficients need the values to be evaluated in F. When they live in a subfield of F,
+    // e.g. M31 under M31Ext3, a coefficient taken in the subfield would only give the soundness of
+    // the subfield to the checks it draws, so such circuits are not supported.
+    bool supports_rand_coefs() const
+    {
+        return std::is_same_v<witness_field_t<F>, F> || nb_rand_coefs() == 0;
+    }
+
+    // coefs holds nb_rand_coefs() values, taken layer by layer, mul gates, add gates then constants.
+    // The outputs change, the circuit has to be evaluated again.
+    // The coefficients are drawn once in F_primitive and shared by all repetitions, so a check built on
+    // them is only as sound as F_primitive, i.e. 31 bits under M31. A circuit that needs more draws
+    // several coefficients and repeats its check with each.
+    void set_rand_coefs(const std::vector<F_primitive>& coefs)
+    {
+        assert(coefs.size() == nb_rand_coefs());
+        assert(supports_rand_coefs());
+        const F_primitive* next = coefs.data();
+        for (CircuitLayer<F, F_primitive>& layer: layers)
+        {
+            layer.mul.set_rand_coefs(next);
+            next += layer.mul.nb_rand_coefs;
+            layer.add.set_rand_coefs(next);
+            next += layer.add.nb_rand_coefs;
+            layer.cst.set_rand_coefs(next);
+            next += layer.cst.nb_rand_coefs;
+        }
+    }
+
     uint32 nb_mul_gates() const
     {
         uint32 sum = 0;
@@ -272,9 +805,12 @@ public:
 
     void evaluate()
     {
+        layers[0].detect_bit_input();
         for (uint32 i = 0; i < layers.size() - 1; ++i)
         {
             layers[i + 1].input_layer_vals.evals = layers[i].evaluate();
+            layers[i + 1].detect_bit_input();
+            layers[i + 1].nb_active_inputs = std::min(layers[i].nb_active_outputs, 1u << layers[i + 1].nb_input_vars);
         }
         layers.back().output_layer_vals.evals = layers.back().evaluate();
     }
@@ -286,20 +822,20 @@ public:
 
     void set_random_input()
     {
-        std::vector<F> &input_layer_vals = layers[0].input_layer_vals.evals;
+        std::vector<witness_field_t<F>> &input_layer_vals = layers[0].input_layer_vals.evals;
         input_layer_vals.clear();
         for (uint32 i = 0; i < (1UL << log_input_size()); i++)
         {
-            input_layer_vals.emplace_back(F::random());
+            input_layer_vals.emplace_back(witness_field_t<F>::random());
         }
     }
     void set_random_boolean_input()
     {
-        std::vector<F> &input_layer_vals = layers[0].input_layer_vals.evals;
+        std::vector<witness_field_t<F>> &input_layer_vals = layers[0].input_layer_vals.evals;
         input_layer_vals.clear();
         for (uint32 i = 0; i < (1 << log_input_size()); i++)
         {
-            input_layer_vals.emplace_back(F::random_bool());
+            input_layer_vals.emplace_back(witness_field_t<F>::random_bool());
         }
     }
 };
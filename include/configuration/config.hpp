@@ -11,6 +11,8 @@ enum Polynomial_commitment_type {
 
 enum Field_type {
     M31,
+    // degree 3 extension of M31, challenges carry enough bits that no repetition is needed
+    M31Ext3,
     BabyBear,
     BN254,
 };
@@ -34,6 +36,8 @@ public:
     int security_bits;
     int grinding_bits;
     int nb_parallel;
+    // number of cores a single proof is split across
+    int nb_threads;
     Polynomial_commitment_type PC_type;
     Field_type field_type;
     FiatShamir_hash_type FS_hash;
@@ -47,6 +51,10 @@ public:
             // TODO: set the value of vectorize_size in VectorizedM31
             vectorize_size = nb_parallel / gkr::M31_field::PackedM31::pack_size();
             break;
+        case M31Ext3:
+            field_size = 93;
+            vectorize_size = nb_parallel / gkr::M31_field::PackedM31::pack_size();
+            break;
         case BabyBear:
             field_size = 31;
             break;
@@ -74,6 +82,7 @@ public:
         security_bits = 100;
         grinding_bits = 10;
         nb_parallel = 16;
+        nb_threads = 1;
         PC_type = Raw;
         field_type = M31;
         FS_hash = SHA256;
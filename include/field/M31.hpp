@@ -196,15 +196,17 @@ public:
     }
     void from_bytes(const uint8* input);
 
+    // the sum of the lanes, kept in 64 bits and reduced once
     M31 sum_packed() const {
-        int *x = (int *)&this->x;
-        int sum_x = 0;
-        for (int i = 0; i < 8; i++)
+        uint32 lanes[sizeof(DATA_TYPE) / sizeof(uint32)];
+        memcpy(lanes, &this->x, sizeof(lanes));
+        uint64 sum_x = 0;
+        for (uint32 lane: lanes)
         {
-            sum_x += *x;
-            x++;
+            sum_x += lane;
         }
-        return M31::new_unchecked(sum_x);
+        sum_x = (sum_x & mod) + (sum_x >> 31);
+        return M31::new_unchecked(sum_x >= static_cast<uint64>(mod) ? sum_x - mod : sum_x);
     }
     
     static PackedM31 pack_full(const M31 &f);
@@ -454,6 +456,48 @@ PackedM31 PackedM31::INV_2 = PackedM31(1 << 30);
 
 } // namespace gkr::M31_field
 
+namespace gkr
+{
+
+// A product of two elements is below 2^62, (x & mod) + (x >> 31) brings it below 2^32 without
+// the final conditional subtraction, so 2^31 such terms can be summed in 64 bits before reducing
+template<>
+class Accumulator<M31_field::M31>
+{
+public:
+    uint64 sum = 0;
+    uint32 nb_terms = 0;
+
+    inline void _add_partial(uint64 x)
+    {
+        sum += (x & M31_field::mod) + (x >> 31);
+        if (++nb_terms == (1U << 31))
+        {
+            sum = (sum & M31_field::mod) + (sum >> 31);
+            nb_terms = 1;
+        }
+    }
+
+    inline void mul_add(const M31_field::M31 &a, const M31_field::M31 &b)
+    {
+        _add_partial(static_cast<uint64>(a.x) * b.x);
+    }
+
+    inline void add(const M31_field::M31 &a)
+    {
+        _add_partial(a.x);
+    }
+
+    M31_field::M31 result() const
+    {
+        uint64 x = (sum & M31_field::mod) + (sum >> 31);
+        x = (x & M31_field::mod) + (x >> 31);
+        return M31_field::M31::new_unchecked(x >= static_cast<uint64>(M31_field::mod) ? x - M31_field::mod : x);
+    }
+};
+
+} // namespace gkr
+
 
 
 
@@ -283,6 +283,133 @@ std::vector<VectorizedM31> VectorizedM31::pack_field_elements(const std::vector<
 
 VectorizedM31 VectorizedM31::INV_2 = VectorizedM31::new_unchecked(_mm256_set1_epi32(1 << 30));
 
+// 0 - bit is all ones where the bit is set, so the product is b masked by it
+inline VectorizedM31 mul_by_bit(const VectorizedM31 &bit, const VectorizedM31 &b)
+{
+    VectorizedM31 r;
+    for (int i = 0; i < vectorize_size; i++)
+    {
+        __m256i mask = _mm256_sub_epi32(_mm256_setzero_si256(), bit.elements[i].x);
+        r.elements[i].x = _mm256_and_si256(b.elements[i].x, mask);
+    }
+    return r;
+}
+
+inline VectorizedM31 mul_by_bit(const VectorizedM31 &bit, const M31 &b)
+{
+    VectorizedM31 r;
+    __m256i b_x = _mm256_set1_epi32(b.x);
+    for (int i = 0; i < vectorize_size; i++)
+    {
+        __m256i mask = _mm256_sub_epi32(_mm256_setzero_si256(), bit.elements[i].x);
+        r.elements[i].x = _mm256_and_si256(b_x, mask);
+    }
+    return r;
+}
+
+}
+
+namespace gkr
+{
+
+// The even and odd 32 bit lanes of every PackedM31 are summed in 64 bit lanes.
+// Products are only partially reduced below 2^32 (two mod_reduce instructions instead of the
+// pack, reduce and conditional subtraction of a full multiply and add), see Accumulator<M31>.
+template<>
+class Accumulator<M31_field::VectorizedM31>
+{
+public:
+    __m256i even[M31_field::vectorize_size];
+    __m256i odd[M31_field::vectorize_size];
+    uint32 nb_terms;
+
+    // mod_reduce of 64 bit lanes
+    static inline __m256i _reduce(__m256i x)
+    {
+        return _mm256_add_epi64(_mm256_and_si256(x, M31_field::packed_mod_epi64), _mm256_srli_epi64(x, 31));
+    }
+
+    Accumulator()
+    {
+        for (int i = 0; i < M31_field::vectorize_size; i++)
+        {
+            even[i] = _mm256_setzero_si256();
+            odd[i] = _mm256_setzero_si256();
+        }
+        nb_terms = 0;
+    }
+
+    inline void _count_term()
+    {
+        if (++nb_terms == (1U << 31))
+        {
+            for (int i = 0; i < M31_field::vectorize_size; i++)
+            {
+                even[i] = _reduce(even[i]);
+                odd[i] = _reduce(odd[i]);
+            }
+            nb_terms = 1;
+        }
+    }
+
+    inline void _mul_add(int i, __m256i a, __m256i b)
+    {
+        __m256i xa_even = _mm256_mul_epu32(a, b);
+        __m256i xa_odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), _mm256_srli_epi64(b, 32));
+        xa_even = _reduce(xa_even);
+        xa_odd = _reduce(xa_odd);
+        even[i] = _mm256_add_epi64(even[i], xa_even);
+        odd[i] = _mm256_add_epi64(odd[i], xa_odd);
+    }
+
+    inline void mul_add(const M31_field::VectorizedM31 &a, const M31_field::VectorizedM31 &b)
+    {
+        for (int i = 0; i < M31_field::vectorize_size; i++)
+        {
+            _mul_add(i, a.elements[i].x, b.elements[i].x);
+        }
+        _count_term();
+    }
+
+    inline void mul_add(const M31_field::VectorizedM31 &a, const M31_field::M31 &b)
+    {
+        __m256i b_x = _mm256_set1_epi32(b.x);
+        for (int i = 0; i < M31_field::vectorize_size; i++)
+        {
+            _mul_add(i, a.elements[i].x, b_x);
+        }
+        _count_term();
+    }
+
+    inline void add(const M31_field::VectorizedM31 &a)
+    {
+        const __m256i low_mask = _mm256_set1_epi64x(0xFFFFFFFFLL);
+        for (int i = 0; i < M31_field::vectorize_size; i++)
+        {
+            even[i] = _mm256_add_epi64(even[i], _mm256_and_si256(a.elements[i].x, low_mask));
+            odd[i] = _mm256_add_epi64(odd[i], _mm256_srli_epi64(a.elements[i].x, 32));
+        }
+        _count_term();
+    }
+
+    M31_field::VectorizedM31 result() const
+    {
+        M31_field::VectorizedM31 r;
+        for (int i = 0; i < M31_field::vectorize_size; i++)
+        {
+            __m256i e = even[i], o = odd[i];
+            // below 2^31 + 2^33, then below 2^31 + 2^3
+            e = _reduce(e);
+            o = _reduce(o);
+            e = _reduce(e);
+            o = _reduce(o);
+            __m256i x = _mm256_or_si256(e, _mm256_slli_epi64(o, 32));
+            r.elements[i].x = _mm256_mask_sub_epi32(x, _mm256_cmpge_epu32_mask(x, M31_field::packed_mod), x, M31_field::packed_mod);
+        }
+        return r;
+    }
+};
+
 }
 #endif
 
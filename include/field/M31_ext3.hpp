@@ -0,0 +1,332 @@
+#pragma once
+
+#include "M31.hpp"
+
+namespace gkr::M31_field {
+
+/*
+Degree 3 extension M31[u] / (u^3 - 5)
+
+u^3 - 5 is irreducible since 3 | P - 1 and 5^((P - 1) / 3) != 1 mod P, i.e. 5 is not a cube.
+An element carries 93 bits, so challenges drawn from it give full soundness with a single
+sumcheck instead of repeating every layer over the 31 bit base field.
+
+(a0 + a1 u + a2 u^2) * (b0 + b1 u + b2 u^2) =
+    (a0 b0 + 5 (a1 b2 + a2 b1)) + (a0 b1 + a1 b0 + 5 a2 b2) u + (a0 b2 + a1 b1 + a2 b0) u^2
+*/
+const uint32 ext3_w = 5;
+
+class M31Ext3 final : public BaseField<M31Ext3, Scalar>,
+                      public FFTFriendlyField<M31Ext3>
+{
+public:
+    static M31Ext3 INV_2;
+
+    M31 v[3];
+
+public:
+    static M31Ext3 zero() { return M31Ext3(); }
+    static M31Ext3 one() { return M31Ext3(1); }
+    static std::tuple<Scalar, uint32> size() { return {mod, 3}; }
+    static M31Ext3 random() { return M31Ext3(M31::random(), M31::random(), M31::random()); } // FIXME: random cannot be used in production
+    static M31Ext3 random_bool() { return M31Ext3(static_cast<uint32>(rand() % 2)); }
+
+public:
+    M31Ext3() {}
+    M31Ext3(uint32 x) { v[0] = M31(x); }
+    M31Ext3(const M31 &x) { v[0] = x; }
+    M31Ext3(const M31 &x0, const M31 &x1, const M31 &x2)
+    {
+        v[0] = x0;
+        v[1] = x1;
+        v[2] = x2;
+    }
+
+    inline M31Ext3 operator+(const M31Ext3 &rhs) const
+    {
+        return M31Ext3(v[0] + rhs.v[0], v[1] + rhs.v[1], v[2] + rhs.v[2]);
+    }
+
+    inline M31Ext3 operator*(const M31Ext3 &rhs) const
+    {
+        const M31 w = M31::new_unchecked(ext3_w);
+        return M31Ext3(
+            v[0] * rhs.v[0] + (v[1] * rhs.v[2] + v[2] * rhs.v[1]) * w,
+            v[0] * rhs.v[1] + v[1] * rhs.v[0] + v[2] * rhs.v[2] * w,
+            v[0] * rhs.v[2] + v[1] * rhs.v[1] + v[2] * rhs.v[0]
+        );
+    }
+
+    inline M31Ext3 operator-() const
+    {
+        return M31Ext3(-v[0], -v[1], -v[2]);
+    }
+
+    inline M31Ext3 operator-(const M31Ext3 &rhs) const
+    {
+        return M31Ext3(v[0] - rhs.v[0], v[1] - rhs.v[1], v[2] - rhs.v[2]);
+    }
+
+    bool operator==(const M31Ext3 &rhs) const
+    {
+        return v[0] == rhs.v[0] && v[1] == rhs.v[1] && v[2] == rhs.v[2];
+    }
+
+    // the default inv in BaseField would need p^3 as exponent, which overflows Scalar
+    M31Ext3 inv() const
+    {
+        const M31 w = M31::new_unchecked(ext3_w);
+        M31 c0 = v[0] * v[0] - v[1] * v[2] * w;
+        M31 c1 = v[2] * v[2] * w - v[0] * v[1];
+        M31 c2 = v[1] * v[1] - v[0] * v[2];
+        M31 t_inv = (v[0] * c0 + (v[2] * c1 + v[1] * c2) * w).inv();
+        return M31Ext3(c0 * t_inv, c1 * t_inv, c2 * t_inv);
+    }
+
+    void to_bytes(uint8 *output) const
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            v[i].to_bytes(output + i * M31::byte_length());
+        }
+    }
+
+    static int byte_length()
+    {
+        return 3 * M31::byte_length();
+    }
+
+    void from_bytes(const uint8 *input)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            v[i].from_bytes(input + i * M31::byte_length());
+        }
+    }
+
+    friend std::ostream &operator<<(std::ostream &os, const M31Ext3 &f)
+    {
+        os << f.v[0];
+        return os;
+    }
+
+    // circuit files only carry base field coefficients
+    friend std::istream &operator>>(std::istream &is, M31Ext3 &f)
+    {
+        is >> f.v[0];
+        f.v[1] = f.v[2] = M31::zero();
+        return is;
+    }
+
+    static M31Ext3 default_rand_sentinel()
+    {
+        return M31Ext3(M31::default_rand_sentinel());
+    }
+};
+
+// SIMD version, each coordinate is a VectorizedM31 so every lane holds an independent element
+class VectorizedM31Ext3 final : public BaseField<VectorizedM31Ext3, Scalar>,
+                                public FFTFriendlyField<VectorizedM31Ext3>
+{
+public:
+    typedef M31Ext3 primitive_type;
+    static VectorizedM31Ext3 INV_2;
+
+    VectorizedM31 v[3];
+
+public:
+    static VectorizedM31Ext3 zero() { return VectorizedM31Ext3(VectorizedM31::zero(), VectorizedM31::zero(), VectorizedM31::zero()); }
+    static VectorizedM31Ext3 one() { return VectorizedM31Ext3(VectorizedM31::one(), VectorizedM31::zero(), VectorizedM31::zero()); }
+    static std::tuple<Scalar, uint32> size() { return {mod, 3}; }
+
+    static VectorizedM31Ext3 random()
+    {
+        return VectorizedM31Ext3(VectorizedM31::random(), VectorizedM31::random(), VectorizedM31::random());
+    }
+
+    static VectorizedM31Ext3 random_bool()
+    {
+        return VectorizedM31Ext3(VectorizedM31::random_bool(), VectorizedM31::zero(), VectorizedM31::zero());
+    }
+
+    static size_t pack_size()
+    {
+        return VectorizedM31::pack_size();
+    }
+
+public:
+    VectorizedM31Ext3() {}
+
+    VectorizedM31Ext3(uint32 x)
+    {
+        v[0] = VectorizedM31(x);
+        v[1] = VectorizedM31::zero();
+        v[2] = VectorizedM31::zero();
+    }
+
+    // embeds base field values lane by lane
+    VectorizedM31Ext3(const VectorizedM31 &x)
+    {
+        v[0] = x;
+        v[1] = VectorizedM31::zero();
+        v[2] = VectorizedM31::zero();
+    }
+
+    VectorizedM31Ext3(const VectorizedM31 &x0, const VectorizedM31 &x1, const VectorizedM31 &x2)
+    {
+        v[0] = x0;
+        v[1] = x1;
+        v[2] = x2;
+    }
+
+    inline VectorizedM31Ext3 operator+(const VectorizedM31Ext3 &rhs) const
+    {
+        return VectorizedM31Ext3(v[0] + rhs.v[0], v[1] + rhs.v[1], v[2] + rhs.v[2]);
+    }
+
+    inline VectorizedM31Ext3 operator+(const M31Ext3 &rhs) const
+    {
+        return VectorizedM31Ext3(v[0] + rhs.v[0], v[1] + rhs.v[1], v[2] + rhs.v[2]);
+    }
+
+    inline VectorizedM31Ext3 operator+(const int &rhs) const
+    {
+        return VectorizedM31Ext3(v[0] + rhs, v[1], v[2]);
+    }
+
+    inline VectorizedM31Ext3 operator*(const VectorizedM31Ext3 &rhs) const
+    {
+        return VectorizedM31Ext3(
+            v[0] * rhs.v[0] + (v[1] * rhs.v[2] + v[2] * rhs.v[1]) * ext3_w,
+            v[0] * rhs.v[1] + v[1] * rhs.v[0] + v[2] * rhs.v[2] * ext3_w,
+            v[0] * rhs.v[2] + v[1] * rhs.v[1] + v[2] * rhs.v[0]
+        );
+    }
+
+    // the common case of a packed value times a challenge, w is folded into the scalar side
+    inline VectorizedM31Ext3 operator*(const M31Ext3 &rhs) const
+    {
+        const M31 w = M31::new_unchecked(ext3_w);
+        M31 w_rhs_1 = rhs.v[1] * w;
+        M31 w_rhs_2 = rhs.v[2] * w;
+        return VectorizedM31Ext3(
+            v[0] * rhs.v[0] + v[1] * w_rhs_2 + v[2] * w_rhs_1,
+            v[0] * rhs.v[1] + v[1] * rhs.v[0] + v[2] * w_rhs_2,
+            v[0] * rhs.v[2] + v[1] * rhs.v[1] + v[2] * rhs.v[0]
+        );
+    }
+
+    inline VectorizedM31Ext3 operator*(const int &rhs) const
+    {
+        return VectorizedM31Ext3(v[0] * rhs, v[1] * rhs, v[2] * rhs);
+    }
+
+    inline VectorizedM31Ext3 operator-() const
+    {
+        return VectorizedM31Ext3(-v[0], -v[1], -v[2]);
+    }
+
+    inline VectorizedM31Ext3 operator-(const VectorizedM31Ext3 &rhs) const
+    {
+        return VectorizedM31Ext3(v[0] - rhs.v[0], v[1] - rhs.v[1], v[2] - rhs.v[2]);
+    }
+
+    inline void operator+=(const VectorizedM31Ext3 &rhs)
+    {
+        v[0] += rhs.v[0];
+        v[1] += rhs.v[1];
+        v[2] += rhs.v[2];
+    }
+
+    bool operator==(const VectorizedM31Ext3 &rhs) const
+    {
+        return v[0] == rhs.v[0] && v[1] == rhs.v[1] && v[2] == rhs.v[2];
+    }
+
+    VectorizedM31Ext3 inv() const
+    {
+        VectorizedM31 c0 = v[0] * v[0] - v[1] * v[2] * ext3_w;
+        VectorizedM31 c1 = v[2] * v[2] * ext3_w - v[0] * v[1];
+        VectorizedM31 c2 = v[1] * v[1] - v[0] * v[2];
+        VectorizedM31 t_inv = (v[0] * c0 + (v[2] * c1 + v[1] * c2) * ext3_w).inv();
+        return VectorizedM31Ext3(c0 * t_inv, c1 * t_inv, c2 * t_inv);
+    }
+
+    std::vector<M31Ext3> unpack() const
+    {
+        std::vector<M31> x0 = v[0].unpack(), x1 = v[1].unpack(), x2 = v[2].unpack();
+        std::vector<M31Ext3> result;
+        for (size_t i = 0; i < x0.size(); i++)
+        {
+            result.emplace_back(M31Ext3(x0[i], x1[i], x2[i]));
+        }
+        return result;
+    }
+
+    void to_bytes(uint8 *output) const
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            v[i].to_bytes(output + i * sizeof(VectorizedM31));
+        }
+    }
+
+    void from_bytes(const uint8 *input)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            v[i].from_bytes(input + i * sizeof(VectorizedM31));
+        }
+    }
+};
+
+M31Ext3 M31Ext3::INV_2 = M31Ext3(1 << 30);
+VectorizedM31Ext3 VectorizedM31Ext3::INV_2 = VectorizedM31Ext3(1 << 30);
+
+// Base field values met by extension ones, i.e. a witness times a challenge or a folded table.
+// Each coordinate is multiplied by the base value, no reduction by u^3 - 5 is needed.
+inline VectorizedM31Ext3 operator*(const VectorizedM31 &lhs, const VectorizedM31Ext3 &rhs)
+{
+    return VectorizedM31Ext3(lhs * rhs.v[0], lhs * rhs.v[1], lhs * rhs.v[2]);
+}
+
+inline VectorizedM31Ext3 operator*(const VectorizedM31 &lhs, const M31Ext3 &rhs)
+{
+    return VectorizedM31Ext3(lhs * rhs.v[0], lhs * rhs.v[1], lhs * rhs.v[2]);
+}
+
+inline VectorizedM31Ext3 operator+(const VectorizedM31 &lhs, const VectorizedM31Ext3 &rhs)
+{
+    return VectorizedM31Ext3(lhs + rhs.v[0], rhs.v[1], rhs.v[2]);
+}
+
+inline VectorizedM31Ext3 mul_by_bit(const VectorizedM31 &bit, const VectorizedM31Ext3 &b)
+{
+    return VectorizedM31Ext3(mul_by_bit(bit, b.v[0]), mul_by_bit(bit, b.v[1]), mul_by_bit(bit, b.v[2]));
+}
+
+inline VectorizedM31Ext3 mul_by_bit(const VectorizedM31 &bit, const M31Ext3 &b)
+{
+    return VectorizedM31Ext3(mul_by_bit(bit, b.v[0]), mul_by_bit(bit, b.v[1]), mul_by_bit(bit, b.v[2]));
+}
+
+// The base field part of a coefficient, exact for the coefficients of circuits over the
+// extension, which are read from base field circuit files
+inline const M31 &witness_part(const M31Ext3 &x)
+{
+    return x.v[0];
+}
+
+} // namespace gkr::M31_field
+
+namespace gkr
+{
+
+// The extension only serves the challenges, the circuit values stay in packed M31
+template<>
+struct WitnessField<M31_field::VectorizedM31Ext3>
+{
+    using type = M31_field::VectorizedM31;
+};
+
+} // namespace gkr
@@ -94,6 +94,59 @@ namespace gkr
     };
 
 
+    // Running sum of products. Fields whose elements fit in half a machine word specialize it
+    // to keep the terms unreduced in wide lanes and reduce once in result(),
+    // the default reduces after every operation.
+    template<typename F>
+    class Accumulator
+    {
+    public:
+        F sum = F::zero();
+
+        template<typename G>
+        inline void mul_add(const F &a, const G &b)
+        {
+            sum += a * b;
+        }
+
+        inline void add(const F &a)
+        {
+            sum += a;
+        }
+
+        F result() const
+        {
+            return sum;
+        }
+    };
+
+    // The field the values of a circuit over F live in. It is F itself unless F only extends it to
+    // draw large enough challenges, see M31_ext3.hpp: the witness then stays in the base field and
+    // the tables of the prover move to F at their first fold.
+    template<typename F>
+    struct WitnessField
+    {
+        using type = F;
+    };
+
+    template<typename F>
+    using witness_field_t = typename WitnessField<F>::type;
+
+    // a * b for an a whose every lane is 0 or 1. Packed fields overload it with a masked select,
+    // see M31_avx.tcc, the default multiplies
+    template<typename F, typename G>
+    inline F mul_by_bit(const F &bit, const G &b)
+    {
+        return bit * b;
+    }
+
+    // True iff every lane of x is 0 or 1, i.e. x^2 = x
+    template<typename F>
+    inline bool is_bit(const F &x)
+    {
+        return x * x == x;
+    }
+
     // TODO: Make the inheritance hierarchy more reasonable
     template<typename F>
     class FFTFriendlyField
@@ -85,11 +85,15 @@ public:
     }
 };
 
+// The value is in the field of evals times x, e.g. base field evaluations at an extension point.
+// Folds one variable at a time, each entry is a single product that the next fold multiplies again,
+// so there is no sum to keep unreduced in an Accumulator.
 template<typename F, typename F_primitive>
-F eval_multilinear(const std::vector<F>& evals, const std::vector<F_primitive>& x)
+auto eval_multilinear(const std::vector<F>& evals, const std::vector<F_primitive>& x)
 {
+    using G = decltype(evals[0] * x[0]);
     assert((1UL << x.size()) == evals.size());
-    std::vector<F> scratch = evals;
+    std::vector<G> scratch(evals.begin(), evals.end());
 
     uint32 cur_eval_size = evals.size() >> 1;
     for (const F_primitive& r: x)
@@ -103,6 +107,44 @@ F eval_multilinear(const std::vector<F>& evals, const std::vector<F_primitive>&
     return scratch[0];
 }
 
+// evals as a table of F, e.g. witness values about to be folded with challenges of F.
+// The copy is only made into storage when evals is in a subfield of F.
+template<typename F, typename W>
+const std::vector<F>& lift_table(const std::vector<W>& evals, std::vector<F>& storage)
+{
+    if constexpr (std::is_same_v<F, W>)
+    {
+        return evals;
+    }
+    else
+    {
+        storage.assign(evals.begin(), evals.end());
+        return storage;
+    }
+}
+
+// The lanes of packed evaluations laid out as one scalar table, lane l of entry i at i * lanes + l.
+// The lane index is thus made of the lowest variables of the scalar multilinear extension.
+template<typename F, typename F_primitive>
+std::vector<F_primitive> unpack_lanes(const std::vector<F>& evals)
+{
+    if constexpr (std::is_same_v<F, F_primitive>)
+    {
+        return evals;
+    }
+    else
+    {
+        std::vector<F_primitive> lanes;
+        lanes.reserve(evals.size() * F::pack_size());
+        for (const F& x: evals)
+        {
+            std::vector<F_primitive> x_lanes = x.unpack();
+            lanes.insert(lanes.end(), x_lanes.begin(), x_lanes.end());
+        }
+        return lanes;
+    }
+}
+
 template<typename F>
 class MultiLinearPoly
 {
@@ -72,7 +72,9 @@ public:
         return c;
     }
     RawOpening open(const std::vector<F_primitive> &x) {return RawOpening();};
-    bool verify(const RawCommitment<F> &commitment, const RawOpening &opening, const std::vector<F_primitive> &x, const F &y)
+    // y is in the field of the point when it extends the one of the values
+    template<typename G>
+    bool verify(const RawCommitment<F> &commitment, const RawOpening &opening, const std::vector<F_primitive> &x, const G &y)
     {
         return eval_multilinear(commitment.poly_vals, x) == y;
     };
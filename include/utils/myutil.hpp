@@ -8,6 +8,10 @@
 
 #include "types.hpp"
 
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
 using namespace std;
 
 void report_timing(string event_name, bool is_start)
@@ -47,4 +51,50 @@ uint32 next_pow_of_2(uint32 n)
     }
 }
 
+// Bitsets are stored as arrays of 64 bit words, entry i is bit i % 64 of word i / 64
+inline uint32 bitset_nb_words(uint32 n)
+{
+    return (n + 63) / 64;
+}
+
+inline void bitset_set(uint64 *words, uint32 i)
+{
+    words[i >> 6] |= 1ULL << (i & 63);
+}
+
+inline bool bitset_get(const uint64 *words, uint32 i)
+{
+    return (words[i >> 6] >> (i & 63)) & 1;
+}
+
+// The positions of the set bits, in increasing order
+inline std::vector<uint32> bitset_to_ids(const std::vector<uint64> &words)
+{
+    std::vector<uint32> ids;
+    for (uint32 w = 0; w < words.size(); w++)
+    {
+        for (uint64 word = words[w]; word != 0; word &= word - 1)
+        {
+            ids.emplace_back(w * 64 + __builtin_ctzll(word));
+        }
+    }
+    return ids;
+}
+
+// Bit j of the result is set iff bit 2j or bit 2j + 1 of x is, i.e. one round of folding a bitset in half
+inline uint64 fold_bit_pairs(uint64 x)
+{
+    x = (x | (x >> 1)) & 0x5555555555555555ULL;
+#if defined(__BMI2__)
+    return _pext_u64(x, 0x5555555555555555ULL);
+#else
+    x = (x | (x >> 1)) & 0x3333333333333333ULL;
+    x = (x | (x >> 2)) & 0x0F0F0F0F0F0F0F0FULL;
+    x = (x | (x >> 4)) & 0x00FF00FF00FF00FFULL;
+    x = (x | (x >> 8)) & 0x0000FFFF0000FFFFULL;
+    x = (x | (x >> 16)) & 0x00000000FFFFFFFFULL;
+    return x;
+#endif
+}
+
 }
\ No newline at end of file
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#include "types.hpp"
+
+namespace gkr
+{
+
+// A persistent pool of worker threads used to split a single proof across cores.
+// The calling thread takes part in every job as worker 0, so a pool of size n
+// spawns n - 1 threads. Jobs are dispatched by parallel_for, which hands each
+// worker one contiguous chunk of [0, n) and returns once all chunks are done.
+class ThreadPool
+{
+private:
+    typedef std::function<void(uint32, uint32, uint32)> Job;
+
+    uint32 nb_threads;
+    std::vector<std::thread> workers;
+
+    std::mutex m;
+    std::condition_variable job_ready, job_done;
+    const Job *job;
+    uint32 job_size;
+    uint64 generation;
+    uint32 nb_pending;
+    bool stopping;
+
+    void _run_chunk(uint32 thread_id, const Job &f, uint32 n)
+    {
+        uint32 chunk = (n + nb_threads - 1) / nb_threads;
+        uint32 begin = std::min(n, thread_id * chunk);
+        uint32 end = std::min(n, begin + chunk);
+        if (begin < end)
+        {
+            f(thread_id, begin, end);
+        }
+    }
+
+    void _worker_loop(uint32 thread_id)
+    {
+        uint64 seen_generation = 0;
+        while (true)
+        {
+            const Job *f;
+            uint32 n;
+            {
+                std::unique_lock<std::mutex> lock(m);
+                job_ready.wait(lock, [&]{ return stopping || generation != seen_generation; });
+                if (stopping)
+                {
+                    return;
+                }
+                seen_generation = generation;
+                f = job;
+                n = job_size;
+            }
+
+            _run_chunk(thread_id, *f, n);
+
+            {
+                std::lock_guard<std::mutex> lock(m);
+                if (--nb_pending == 0)
+                {
+                    job_done.notify_one();
+                }
+            }
+        }
+    }
+
+public:
+    explicit ThreadPool(uint32 nb_threads_)
+    {
+        nb_threads = std::max(nb_threads_, 1u);
+        job = nullptr;
+        job_size = 0;
+        generation = 0;
+        nb_pending = 0;
+        stopping = false;
+        for (uint32 i = 1; i < nb_threads; i++)
+        {
+            workers.emplace_back(&ThreadPool::_worker_loop, this, i);
+        }
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m);
+            stopping = true;
+        }
+        job_ready.notify_all();
+        for (std::thread &t: workers)
+        {
+            t.join();
+        }
+    }
+
+    uint32 size() const
+    {
+        return nb_threads;
+    }
+
+    // f(thread_id, begin, end) is called once per worker with a disjoint range,
+    // the ranges cover [0, n) and thread_id is in [0, size())
+    void parallel_for(uint32 n, const Job &f)
+    {
+        if (nb_threads == 1)
+        {
+            f(0, 0, n);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m);
+            job = &f;
+            job_size = n;
+            nb_pending = nb_threads - 1;
+            generation++;
+        }
+        job_ready.notify_all();
+
+        _run_chunk(0, f, n);
+
+        std::unique_lock<std::mutex> lock(m);
+        job_done.wait(lock, [&]{ return nb_pending == 0; });
+    }
+};
+
+// Below this many iterations a loop is run on the calling thread only,
+// waking the workers would cost more than it saves
+const uint32 PARALLEL_GRAIN_SIZE = 1 << 12;
+
+// Runs f on the pool if there is one and the loop is large enough, serially otherwise.
+// Loops with heavier iterations, e.g. over the words of a bitset, pass a smaller grain.
+inline void parallel_for(ThreadPool *pool, uint32 n, const std::function<void(uint32, uint32, uint32)> &f,
+    uint32 grain = PARALLEL_GRAIN_SIZE)
+{
+    if (pool == nullptr || n < grain)
+    {
+        f(0, 0, n);
+    }
+    else
+    {
+        pool->parallel_for(n, f);
+    }
+}
+
+inline uint32 nb_workers(const ThreadPool *pool)
+{
+    return pool == nullptr ? 1 : pool->size();
+}
+
+}
@@ -2,6 +2,7 @@
 #include <gtest/gtest.h>
 
 #include "field/M31.hpp"
+#include "field/M31_ext3.hpp"
 #include "LinearGKR/gkr.hpp"
 #include "LinearGKR/LinearGKR.hpp"
 
@@ -31,6 +32,404 @@ TEST(GKR_TEST, GKR_WITH_PC_TEST)
     EXPECT_TRUE(verified);
 }
 
+TEST(GKR_TEST, GKR_MULTI_THREAD_TEST)
+{
+    using namespace gkr;
+    using F = gkr::M31_field::VectorizedM31;
+    using F_primitive = gkr::M31_field::M31;
+
+    // large enough for the bookkeeping loops to be split across the pool
+    uint32 n_layers = 3;
+    Circuit<F, F_primitive> circuit;
+    for (int i = n_layers - 1; i >= 0; --i)
+    {
+        circuit.layers.emplace_back(CircuitLayer<F, F_primitive>::random(i + 13, i + 14));
+    }
+    // mix in the other coefficient types
+    for (CircuitLayer<F, F_primitive> &layer: circuit.layers)
+    {
+        for (size_t j = 0; j < layer.mul.sparse_evals.size(); j++)
+        {
+            layer.mul.sparse_evals[j].coef = j % 3 == 0 ? -F_primitive::one() : F_primitive(j % 5 + 1);
+        }
+        for (size_t j = 0; j < layer.add.sparse_evals.size(); j++)
+        {
+            layer.add.sparse_evals[j].coef = j % 4 == 0 ? -F_primitive::one() : F_primitive(j % 7 + 1);
+        }
+    }
+    circuit.compile();
+    circuit.evaluate();
+
+    Config single_thread_config{};
+    Prover<F, F_primitive> single_thread_prover(single_thread_config);
+    single_thread_prover.prepare_mem(circuit);
+    Proof<F> single_thread_proof = std::get<1>(single_thread_prover.prove(circuit));
+
+    Config multi_thread_config{};
+    multi_thread_config.nb_threads = 4;
+    Prover<F, F_primitive> prover(multi_thread_config);
+    prover.prepare_mem(circuit);
+    auto t = prover.prove(circuit);
+    auto claimed_v = std::get<0>(t);
+    Proof<F> proof = std::get<1>(t);
+    EXPECT_EQ(proof.bytes, single_thread_proof.bytes);
+
+    Verifier verifier(multi_thread_config);
+    bool verified = verifier.verify(circuit, claimed_v, proof);
+    EXPECT_TRUE(verified);
+}
+
+TEST(GKR_TEST, GKR_BIT_INPUT_TEST)
+{
+    using namespace gkr;
+    using F = gkr::M31_field::VectorizedM31;
+    using F_primitive = gkr::M31_field::M31;
+
+    uint32 n_layers = 3;
+    Circuit<F, F_primitive> circuit;
+    for (int i = n_layers - 1; i >= 0; --i)
+    {
+        circuit.layers.emplace_back(CircuitLayer<F, F_primitive>::random(i + 11, i + 12));
+    }
+    circuit.set_random_boolean_input();
+    circuit.evaluate();
+    EXPECT_TRUE(circuit.layers[0].input_is_bits);
+    EXPECT_FALSE(circuit.layers[1].input_is_bits);
+
+    Config config{};
+    config.nb_threads = 4;
+    Prover<F, F_primitive> prover(config);
+    prover.prepare_mem(circuit);
+    auto t = prover.prove(circuit);
+    auto claimed_v = std::get<0>(t);
+    Proof<F> proof = std::get<1>(t);
+
+    // the selects compute the same sums as the multiplications
+    circuit.layers[0].input_is_bits = false;
+    Prover<F, F_primitive> reference_prover(config);
+    reference_prover.prepare_mem(circuit);
+    Proof<F> reference_proof = std::get<1>(reference_prover.prove(circuit));
+    EXPECT_EQ(proof.bytes, reference_proof.bytes);
+
+    Verifier verifier(config);
+    EXPECT_TRUE(verifier.verify(circuit, claimed_v, proof));
+}
+
+TEST(GKR_TEST, GKR_SPARSE_LAYER_TEST)
+{
+    using namespace gkr;
+    using F = gkr::M31_field::VectorizedM31;
+    using F_primitive = gkr::M31_field::M31;
+
+    // far fewer gates than inputs, the lists are folded until they are dense enough
+    Circuit<F, F_primitive> circuit;
+    circuit.layers.emplace_back(CircuitLayer<F, F_primitive>::random(8, 14));
+    circuit.layers.emplace_back(CircuitLayer<F, F_primitive>::random(4, 8));
+    circuit.layers.emplace_back(CircuitLayer<F, F_primitive>::random(2, 4));
+    circuit.evaluate();
+    const CircuitLayer<F, F_primitive>& sparse_layer = circuit.layers[0];
+    EXPECT_TRUE((SumcheckMultiLinearProdHelper<F, F_primitive>::use_sparse(sparse_layer.phase_one_gate_ids.size(), 1 << sparse_layer.nb_input_vars)));
+    EXPECT_TRUE((SumcheckMultiLinearProdHelper<F, F_primitive>::use_sparse(sparse_layer.phase_two_gate_ids.size(), 1 << sparse_layer.nb_input_vars)));
+
+    Config single_thread_config{};
+    Prover<F, F_primitive> single_thread_prover(single_thread_config);
+    single_thread_prover.prepare_mem(circuit);
+    Proof<F> single_thread_proof = std::get<1>(single_thread_prover.prove(circuit));
+
+    Config config{};
+    config.nb_threads = 4;
+    Prover<F, F_primitive> prover(config);
+    prover.prepare_mem(circuit);
+    auto t = prover.prove(circuit);
+    auto claimed_v = std::get<0>(t);
+    Proof<F> proof = std::get<1>(t);
+    EXPECT_EQ(proof.bytes, single_thread_proof.bytes);
+
+    Verifier verifier(config);
+    EXPECT_TRUE(verifier.verify(circuit, claimed_v, proof));
+
+    proof.reset();
+    claimed_v[0] += F::one();
+    EXPECT_FALSE(verifier.verify(circuit, claimed_v, proof));
+}
+
+TEST(GKR_TEST, GKR_ACTIVE_SIZE_TEST)
+{
+    using namespace gkr;
+    using F = gkr::M31_field::VectorizedM31;
+    using F_primitive = gkr::M31_field::M31;
+
+    Circuit<F, F_primitive> circuit;
+    circuit.layers.emplace_back(CircuitLayer<F, F_primitive>::random(9, 10));
+    circuit.layers.emplace_back(CircuitLayer<F, F_primitive>::random(7, 9));
+    circuit.layers.emplace_back(CircuitLayer<F, F_primitive>::random(5, 7));
+    // the first layer only writes an odd number of its outputs, the rest of the next input is padding
+    uint32 nb_outputs = 301;
+    CircuitLayer<F, F_primitive>& first = circuit.layers[0];
+    std::erase_if(first.mul.sparse_evals, [&](const auto& gate) { return gate.o_id >= nb_outputs; });
+    std::erase_if(first.add.sparse_evals, [&](const auto& gate) { return gate.o_id >= nb_outputs; });
+    first.compile();
+    circuit.evaluate();
+    EXPECT_EQ(circuit.layers[1].nb_active_inputs, nb_outputs);
+    EXPECT_EQ(circuit.layers[2].nb_active_inputs, 1u << 7);
+
+    Config single_thread_config{};
+    Prover<F, F_primitive> single_thread_prover(single_thread_config);
+    single_thread_prover.prepare_mem(circuit);
+    Proof<F> single_thread_proof = std::get<1>(single_thread_prover.prove(circuit));
+
+    Config config{};
+    config.nb_threads = 4;
+    Prover<F, F_primitive> prover(config);
+    prover.prepare_mem(circuit);
+    auto t = prover.prove(circuit);
+    auto claimed_v = std::get<0>(t);
+    Proof<F> proof = std::get<1>(t);
+    EXPECT_EQ(proof.bytes, single_thread_proof.bytes);
+
+    Verifier verifier(config);
+    EXPECT_TRUE(verifier.verify(circuit, claimed_v, proof));
+}
+
+TEST(GKR_TEST, COMPUTE_NB_VARS_TEST)
+{
+    using namespace gkr;
+    using F = gkr::M31_field::VectorizedM31;
+    using F_primitive = gkr::M31_field::M31;
+
+    // the largest ids are powers of two, so one more variable is needed to hold them
+    Circuit<F, F_primitive> circuit;
+    circuit.layers.resize(1);
+    uint32 i_ids[1] = {4};
+    circuit.layers[0].add.sparse_evals.emplace_back(Gate<F_primitive, 1>(8, i_ids, F_primitive::one()));
+    circuit._compute_nb_vars();
+    EXPECT_EQ(circuit.layers[0].nb_input_vars, 3);
+    EXPECT_EQ(circuit.layers[0].nb_output_vars, 4);
+}
+
+TEST(GKR_TEST, GKR_SINGLE_INSTANCE_TEST)
+{
+    using namespace gkr;
+    using F = gkr::M31_field::M31;
+    using F_primitive = gkr::M31_field::M31;
+
+    // one circuit instance, the bookkeeping tables are packed along the hypercube instead.
+    // The small layers have fewer entries than a packed element.
+    std::vector<uint32> nb_vars{11, 10, 9, 3, 2, 1};
+    Circuit<F, F_primitive> circuit;
+    for (uint32 i = 0; i + 1 < nb_vars.size(); i++)
+    {
+        circuit.layers.emplace_back(CircuitLayer<F, F_primitive>::random(nb_vars[i + 1], nb_vars[i]));
+    }
+    for (CircuitLayer<F, F_primitive> &layer: circuit.layers)
+    {
+        for (size_t j = 0; j < layer.mul.sparse_evals.size(); j++)
+        {
+            layer.mul.sparse_evals[j].coef = j % 3 == 0 ? -F_primitive::one() : F_primitive(j % 5 + 1);
+        }
+    }
+    circuit.compile();
+    circuit.evaluate();
+
+    Config single_thread_config{};
+    Prover<F, F_primitive> single_thread_prover(single_thread_config);
+    single_thread_prover.prepare_mem(circuit);
+    Proof<F> single_thread_proof = std::get<1>(single_thread_prover.prove(circuit));
+
+    Config config{};
+    config.nb_threads = 4;
+    Prover<F, F_primitive> prover(config);
+    prover.prepare_mem(circuit);
+    auto t = prover.prove(circuit);
+    auto claimed_v = std::get<0>(t);
+    Proof<F> proof = std::get<1>(t);
+    EXPECT_EQ(proof.bytes, single_thread_proof.bytes);
+
+    Verifier verifier(config);
+    EXPECT_TRUE(verifier.verify(circuit, claimed_v, proof));
+
+    proof.reset();
+    claimed_v[0] += F::one();
+    EXPECT_FALSE(verifier.verify(circuit, claimed_v, proof));
+}
+
+TEST(GKR_TEST, GKR_EXT3_TEST)
+{
+    using namespace gkr;
+    using F = gkr::M31_field::VectorizedM31Ext3;
+    using F_primitive = gkr::M31_field::M31Ext3;
+    using W = gkr::M31_field::VectorizedM31;
+
+    uint32 n_layers = 4;
+    Circuit<F, F_primitive> circuit;
+    for (int i = n_layers - 1; i >= 0; --i)
+    {
+        circuit.layers.emplace_back(CircuitLayer<F, F_primitive>::random(i + 1, i + 2));
+    }
+    // the values stay in the base field, the extension only serves the challenges
+    static_assert(std::is_same_v<decltype(circuit.layers[0].input_layer_vals.evals), std::vector<W>>);
+    circuit.set_random_input();
+    circuit.evaluate();
+    Circuit<F, F_primitive> verifier_circuit = circuit;
+
+    Config config{};
+    config.field_type = Field_type::M31Ext3;
+    config.initialize_config();
+    EXPECT_EQ(config.get_num_repetitions(), 1);
+
+    Prover<F, F_primitive> prover(config);
+    prover.prepare_mem(circuit);
+    auto t = prover.prove(circuit);
+    auto claimed_v = std::get<0>(t);
+    Proof<F> proof = std::get<1>(t);
+
+    Verifier verifier(config);
+    EXPECT_TRUE(verifier.verify(verifier_circuit, claimed_v, proof));
+
+    proof.reset();
+    claimed_v[0] += F::one();
+    EXPECT_FALSE(verifier.verify(verifier_circuit, claimed_v, proof));
+
+    // a boolean input, folded with selects by the extension challenges
+    circuit.set_random_boolean_input();
+    verifier_circuit = circuit;
+    circuit.evaluate();
+    EXPECT_TRUE(circuit.layers[0].input_is_bits);
+    prover.prepare_mem(circuit);
+    auto [claimed_v_bits, proof_bits] = prover.prove(circuit);
+    EXPECT_TRUE(verifier.verify(verifier_circuit, claimed_v_bits, proof_bits));
+
+    // a batch of base field witnesses
+    std::vector<std::vector<W>> witnesses(4);
+    for (std::vector<W>& witness: witnesses)
+    {
+        witness = MultiLinearPoly<W>::random(circuit.log_input_size()).evals;
+    }
+    auto [claimed_v_batch, proof_batch] = prover.prove(circuit, witnesses);
+    EXPECT_TRUE(verifier.verify(verifier_circuit, witnesses.size(), claimed_v_batch, proof_batch));
+
+    // random coefficients would have to be evaluated in the extension, such circuits are rejected
+    CircuitLayer<F, F_primitive>& layer = verifier_circuit.layers.back();
+    uint32 in[2] = {0, (1u << layer.nb_input_vars) - 1};
+    layer.mul.sparse_evals.emplace_back(Gate<F_primitive, 2>(1, in, Segment<F_primitive>::current_rand_sentinel));
+    layer.mul.nb_rand_coefs++;
+    layer.compile();
+    EXPECT_FALSE(verifier_circuit.supports_rand_coefs());
+    proof_bits.reset();
+    EXPECT_FALSE(verifier.verify(verifier_circuit, claimed_v_bits, proof_bits));
+}
+
+TEST(GKR_TEST, GKR_COMBINE_CLAIMS_TEST)
+{
+    using namespace gkr;
+    using F = gkr::M31_field::VectorizedM31;
+    using F_primitive = gkr::M31_field::M31;
+
+    Circuit<F, F_primitive> circuit;
+    circuit.layers.emplace_back(CircuitLayer<F, F_primitive>::random(5, 6));
+    circuit.evaluate();
+    const CircuitLayer<F, F_primitive>& layer = circuit.layers[0];
+
+    Config config{};
+    uint32 nb_repetitions = config.get_num_repetitions();
+    std::vector<std::vector<F_primitive>> rz1(nb_repetitions), rz2(nb_repetitions);
+    std::vector<F> v1, v2;
+    for (uint32 j = 0; j < nb_repetitions; j++)
+    {
+        for (uint32 i = 0; i < layer.nb_input_vars; i++)
+        {
+            rz1[j].emplace_back(F_primitive::random());
+            rz2[j].emplace_back(F_primitive::random());
+        }
+        v1.emplace_back(eval_multilinear(layer.input_layer_vals.evals, rz1[j]));
+        v2.emplace_back(eval_multilinear(layer.input_layer_vals.evals, rz2[j]));
+    }
+
+    std::vector<GKRScratchPad<F, F_primitive>> scratch_pad(nb_repetitions);
+    for (GKRScratchPad<F, F_primitive>& pad: scratch_pad)
+    {
+        pad.prepare(circuit);
+    }
+    Transcript<F, F_primitive> prover_transcript;
+    auto rs = sumcheck_prove_combine_claims(layer, rz1, rz2, prover_transcript, scratch_pad.data(), config);
+    Proof<F> proof = prover_transcript.proof;
+    // two values per round message, then the claim
+    EXPECT_EQ(proof.bytes.size(), (2 * layer.nb_input_vars + 1) * nb_repetitions * sizeof(F));
+
+    // the single claim is v at the new point
+    Transcript<F, F_primitive> verifier_transcript;
+    auto t = sumcheck_verify_combine_claims(layer, rz1, rz2, v1, v2, proof, verifier_transcript, config);
+    EXPECT_TRUE(std::get<0>(t));
+    EXPECT_EQ(std::get<1>(t), rs);
+    for (uint32 j = 0; j < nb_repetitions; j++)
+    {
+        EXPECT_EQ(std::get<2>(t)[j], eval_multilinear(layer.input_layer_vals.evals, rs[j]));
+    }
+
+    proof.reset();
+    v2[0] += F::one();
+    Transcript<F, F_primitive> tampered_transcript;
+    EXPECT_FALSE(std::get<0>(sumcheck_verify_combine_claims(layer, rz1, rz2, v1, v2, proof, tampered_transcript, config)));
+}
+
+TEST(GKR_TEST, CIRCUIT_COMPILE_TEST)
+{
+    using namespace gkr;
+    using F_primitive = gkr::M31_field::M31;
+
+    SparseCircuitConnection<F_primitive, 2> mul;
+    uint32 gates[][4] = {{3, 1, 0, 2}, {0, 1, 1, 5}, {1, 3, 2, 7}, {2, 1, 3, 1}, {0, 0, 2, 4}, {1, 2, 0, M31_field::mod - 1}};
+    for (auto &g: gates)
+    {
+        uint32 i_ids[2] = {g[1], g[2]};
+        mul.sparse_evals.emplace_back(Gate<F_primitive, 2>(g[0], i_ids, F_primitive(g[3])));
+    }
+    EXPECT_FALSE(mul.is_compiled());
+    mul.compile();
+    EXPECT_TRUE(mul.is_compiled());
+
+    // unit, then minus one, then the general gates in their original order
+    EXPECT_EQ(mul.coef_type_starts[1], 1);
+    EXPECT_EQ(mul.coef_type_starts[2], 2);
+    EXPECT_EQ(mul.coef_type_starts[3], mul.sparse_evals.size());
+    EXPECT_EQ(mul.sparse_evals[0].o_id, 2);
+    EXPECT_EQ(mul.sparse_evals[1].o_id, 1);
+    EXPECT_EQ(mul.sparse_evals[2].o_id, 3);
+
+    for (uint32 k = 0; k < 2; k++)
+    {
+        uint32 nb_gates = 0;
+        for (uint32 t = 0; t < nb_coef_types; t++)
+        {
+            const GateCSR<F_primitive> &csr = mul.by_input[k][t];
+            EXPECT_EQ(csr.row_starts.back(), mul.coef_type_starts[t + 1] - mul.coef_type_starts[t]);
+            for (uint32 row = 0; row < csr.nb_rows(); row++)
+            {
+                if (row > 0)
+                {
+                    EXPECT_LT(csr.row_ids[row - 1], csr.row_ids[row]);
+                }
+                for (uint32 i = csr.row_starts[row]; i < csr.row_starts[row + 1]; i++)
+                {
+                    // every compiled entry matches one of the original gates
+                    bool found = false;
+                    for (const Gate<F_primitive, 2> &gate: mul.sparse_evals)
+                    {
+                        found |= gate.i_ids[k] == csr.row_ids[row] && gate.i_ids[1 - k] == csr.other_ids[i]
+                            && gate.o_id == csr.o_ids[i] && gate.coef == csr.coefs[i];
+                    }
+                    EXPECT_TRUE(found);
+                    EXPECT_EQ(static_cast<uint32>(coef_type_of(csr.coefs[i])), t);
+                    nb_gates++;
+                }
+            }
+        }
+        EXPECT_EQ(nb_gates, mul.sparse_evals.size());
+    }
+    EXPECT_EQ(mul.by_input[0][2].nb_rows(), 3);
+    EXPECT_EQ(mul.by_input[1][2].nb_rows(), 3);
+}
+
 TEST(GKR_TEST, GKR_CORRECTNESS_TEST)
 {
     Config config{};
@@ -79,6 +478,442 @@ TEST(GKR_TEST, GKR_CORRECTNESS_TEST)
 }
 
 
+TEST(GKR_TEST, GKR_LINEAR_LAYER_TEST)
+{
+    Config config{};
+    using namespace gkr;
+    using F = gkr::M31_field::VectorizedM31;
+    using F_primitive = gkr::M31_field::M31;
+    uint32 n_layers = 4;
+    Circuit<F, F_primitive> circuit;
+    for (int i = n_layers - 1; i >= 0; --i)
+    {
+        circuit.layers.emplace_back(CircuitLayer<F, F_primitive>::random(i + 1, i + 2));
+        // every other layer, including the input layer circuit.layers[0], only relays its inputs
+        if (i % 2 == 1)
+        {
+            CircuitLayer<F, F_primitive>& layer = circuit.layers.back();
+            layer.mul.sparse_evals.clear();
+            layer.compile();
+            EXPECT_TRUE(layer.is_linear());
+        }
+    }
+    circuit.evaluate();
+
+    std::vector<GKRScratchPad<F, F_primitive>> scratch_pad(config.get_num_repetitions());
+    for (GKRScratchPad<F, F_primitive>& pad: scratch_pad)
+    {
+        pad.prepare(circuit);
+    }
+    Transcript<F, F_primitive> prover_transcript;
+    auto t = gkr_prove<F, F_primitive>(circuit, scratch_pad.data(), prover_transcript, config);
+    auto claimed_value = std::get<0>(t);
+
+    // a linear layer sends nb_input_vars round messages and the vx claim only,
+    // a round message is two values
+    uint32 nb_elements = 0;
+    for (const CircuitLayer<F, F_primitive>& layer: circuit.layers)
+    {
+        nb_elements += layer.is_linear() ? 2 * layer.nb_input_vars + 1 : 4 * layer.nb_input_vars + 2;
+    }
+    Proof<F> &proof = prover_transcript.proof;
+    EXPECT_EQ(proof.bytes.size(), nb_elements * config.get_num_repetitions() * sizeof(F));
+
+    Transcript<F, F_primitive> verifier_transcript;
+    auto verify_t = gkr_verify<F, F_primitive>(circuit, claimed_value, verifier_transcript, proof, config);
+    EXPECT_TRUE(std::get<0>(verify_t));
+
+    // the input layer is linear, both claims are on v(rx)
+    for (int i = 0; i < config.get_num_repetitions(); i++)
+    {
+        EXPECT_EQ(std::get<1>(verify_t)[i], std::get<2>(verify_t)[i]);
+        EXPECT_EQ(std::get<3>(verify_t)[i], eval_multilinear(circuit.layers[0].input_layer_vals.evals, std::get<1>(verify_t)[i]));
+    }
+
+    proof.reset();
+    Transcript<F, F_primitive> verifier_transcript_fail;
+    for (int i = 0; i < config.get_num_repetitions(); i++)
+    {
+        claimed_value[i] += F::one();
+    }
+    EXPECT_FALSE(std::get<0>(gkr_verify<F, F_primitive>(circuit, claimed_value, verifier_transcript_fail, proof, config)));
+}
+
+TEST(GKR_TEST, GKR_POW_GATE_TEST)
+{
+    Config config{};
+    using namespace gkr;
+    using F = gkr::M31_field::VectorizedM31;
+    using F_primitive = gkr::M31_field::M31;
+    uint32 n_layers = 4;
+    Circuit<F, F_primitive> circuit;
+    for (int i = n_layers - 1; i >= 0; --i)
+    {
+        circuit.layers.emplace_back(CircuitLayer<F, F_primitive>::random(i + 1, i + 2));
+        CircuitLayer<F, F_primitive>& layer = circuit.layers.back();
+        // x^5 and cubic gates with general coefficients, on top of a linear layer for i = 1
+        layer.pow_degree = i % 2 == 0 ? 5 : 3;
+        for (uint32 o = 0; o < (1u << layer.nb_output_vars); o++)
+        {
+            uint32 in[1] = {(3 * o + 1) % (1u << layer.nb_input_vars)};
+            layer.pow.sparse_evals.emplace_back(Gate<F_primitive, 1>(o, in, F_primitive::random()));
+        }
+        if (i == 1)
+        {
+            layer.mul.sparse_evals.clear();
+        }
+        layer.compile();
+        EXPECT_EQ(layer.phase_one_degree(), layer.pow_degree + 1);
+    }
+    circuit.evaluate();
+
+    // only the power gates of the output layer
+    CircuitLayer<F, F_primitive> pow_only = circuit.layers.back();
+    pow_only.add.sparse_evals.clear();
+    pow_only.mul.sparse_evals.clear();
+    pow_only.compile();
+    std::vector<F> out = pow_only.evaluate();
+    for (const auto& gate: pow_only.pow.sparse_evals)
+    {
+        const F& x = pow_only.input_layer_vals.evals[gate.i_ids[0]];
+        EXPECT_EQ(out[gate.o_id], x * x * x * x * x * gate.coef);
+    }
+
+    std::vector<GKRScratchPad<F, F_primitive>> scratch_pad(config.get_num_repetitions());
+    for (GKRScratchPad<F, F_primitive>& pad: scratch_pad)
+    {
+        pad.prepare(circuit);
+    }
+    Transcript<F, F_primitive> prover_transcript;
+    auto t = gkr_prove<F, F_primitive>(circuit, scratch_pad.data(), prover_transcript, config);
+    auto claimed_value = std::get<0>(t);
+
+    // phase one round messages are degree + 1 values, phase two ones two
+    uint32 nb_elements = 0;
+    for (const CircuitLayer<F, F_primitive>& layer: circuit.layers)
+    {
+        nb_elements += layer.phase_one_degree() * layer.nb_input_vars + 1;
+        nb_elements += layer.is_linear() ? 0 : 2 * layer.nb_input_vars + 1;
+    }
+    Proof<F> &proof = prover_transcript.proof;
+    EXPECT_EQ(proof.bytes.size(), nb_elements * config.get_num_repetitions() * sizeof(F));
+
+    Transcript<F, F_primitive> verifier_transcript;
+    EXPECT_TRUE(std::get<0>(gkr_verify<F, F_primitive>(circuit, claimed_value, verifier_transcript, proof, config)));
+
+    proof.reset();
+    Transcript<F, F_primitive> verifier_transcript_fail;
+    for (int i = 0; i < config.get_num_repetitions(); i++)
+    {
+        claimed_value[i] += F::one();
+    }
+    EXPECT_FALSE(std::get<0>(gkr_verify<F, F_primitive>(circuit, claimed_value, verifier_transcript_fail, proof, config)));
+}
+
+TEST(GKR_TEST, GKR_RAND_COEF_TEST)
+{
+    using namespace gkr;
+    using F = gkr::M31_field::VectorizedM31;
+    using F_primitive = gkr::M31_field::M31;
+    Config config{};
+
+    uint32 n_layers = 3;
+    Circuit<F, F_primitive> circuit;
+    for (int i = n_layers - 1; i >= 0; --i)
+    {
+        circuit.layers.emplace_back(CircuitLayer<F, F_primitive>::random(i + 2, i + 3));
+        CircuitLayer<F, F_primitive>& layer = circuit.layers.back();
+        // random linear combinations of the inputs on top of the relays
+        for (uint32 o = 0; o < (1u << layer.nb_output_vars); o += 3)
+        {
+            uint32 in_mul[2] = {o % (1u << layer.nb_input_vars), (o + 1) % (1u << layer.nb_input_vars)};
+            uint32 in_add[1] = {(o + 2) % (1u << layer.nb_input_vars)};
+            layer.mul.sparse_evals.emplace_back(Gate<F_primitive, 2>(o, in_mul, Segment<F_primitive>::current_rand_sentinel));
+            layer.add.sparse_evals.emplace_back(Gate<F_primitive, 1>(o, in_add, Segment<F_primitive>::current_rand_sentinel));
+            layer.mul.nb_rand_coefs++;
+            layer.add.nb_rand_coefs++;
+        }
+        layer.compile();
+    }
+    circuit.evaluate();
+    Circuit<F, F_primitive> verifier_circuit = circuit;
+    // the same gates, proven with coefficients fixed in advance
+    Circuit<F, F_primitive> fixed_circuit = circuit;
+    fixed_circuit.set_rand_coefs(std::vector<F_primitive>(circuit.nb_rand_coefs(), F_primitive(7)));
+    for (CircuitLayer<F, F_primitive>& layer: fixed_circuit.layers)
+    {
+        layer.mul.nb_rand_coefs = layer.add.nb_rand_coefs = 0;
+    }
+    fixed_circuit.evaluate();
+
+    Prover<F, F_primitive> prover(config);
+    prover.prepare_mem(circuit);
+    auto [claimed_v, proof] = prover.prove(circuit);
+    Verifier verifier(config);
+    EXPECT_TRUE(verifier.verify(verifier_circuit, claimed_v, proof));
+
+    // the prover set the coefficients it drew, the verifier's circuit is left as given and checks the proof again
+    for (uint32 i = 0; i < n_layers; i++)
+    {
+        const auto& mul = circuit.layers[i].mul.sparse_evals;
+        const auto& verifier_mul = verifier_circuit.layers[i].mul.sparse_evals;
+        EXPECT_NE(mul.back().coef, Segment<F_primitive>::current_rand_sentinel);
+        EXPECT_EQ(verifier_mul.back().coef, Segment<F_primitive>::current_rand_sentinel);
+    }
+    proof.reset();
+    EXPECT_TRUE(verifier.verify(verifier_circuit, claimed_v, proof));
+
+    Prover<F, F_primitive> prover_fixed(config);
+    prover_fixed.prepare_mem(fixed_circuit);
+    auto [claimed_v_fixed, proof_fixed] = prover_fixed.prove(fixed_circuit);
+    EXPECT_FALSE(verifier.verify(verifier_circuit, claimed_v_fixed, proof_fixed));
+}
+
+TEST(GKR_TEST, GKR_CONST_GATE_TEST)
+{
+    using namespace gkr;
+    using F = gkr::M31_field::VectorizedM31;
+    using F_primitive = gkr::M31_field::M31;
+    Config config{};
+
+    uint32 n_layers = 4;
+    Circuit<F, F_primitive> circuit;
+    for (int i = n_layers - 1; i >= 0; --i)
+    {
+        circuit.layers.emplace_back(CircuitLayer<F, F_primitive>::random(i + 1, i + 2));
+        CircuitLayer<F, F_primitive>& layer = circuit.layers.back();
+        // constants on every other output, one of them random, on top of a linear layer for i = 1
+        for (uint32 o = 0; o < (1u << layer.nb_output_vars); o += 2)
+        {
+            layer.cst.sparse_evals.emplace_back(ConstGate<F_primitive>{o, F_primitive::random()});
+        }
+        layer.cst.sparse_evals.emplace_back(ConstGate<F_primitive>{1, Segment<F_primitive>::current_rand_sentinel});
+        layer.cst.nb_rand_coefs = 1;
+        if (i == 1)
+        {
+            layer.mul.sparse_evals.clear();
+        }
+        layer.compile();
+    }
+    circuit.evaluate();
+    Circuit<F, F_primitive> verifier_circuit = circuit;
+
+    // only the constants of the output layer
+    CircuitLayer<F, F_primitive> cst_only = circuit.layers.back();
+    cst_only.add.sparse_evals.clear();
+    cst_only.mul.sparse_evals.clear();
+    cst_only.compile();
+    std::vector<F> out = cst_only.evaluate();
+    EXPECT_EQ(out[0], F::zero() + cst_only.cst.sparse_evals[0].coef);
+
+    Prover<F, F_primitive> prover(config);
+    prover.prepare_mem(circuit);
+    auto [claimed_v, proof] = prover.prove(circuit);
+    Verifier verifier(config);
+    EXPECT_TRUE(verifier.verify(verifier_circuit, claimed_v, proof));
+    EXPECT_EQ(verifier_circuit.layers[0].cst.sparse_evals.back().coef, Segment<F_primitive>::current_rand_sentinel);
+
+    // the verifier has to account for every constant
+    Circuit<F, F_primitive> other_cst_circuit = circuit;
+    other_cst_circuit.layers[2].cst.sparse_evals[0].coef += F_primitive::one();
+    EXPECT_FALSE(verifier.verify(other_cst_circuit, claimed_v, proof));
+}
+
+TEST(GKR_TEST, GKR_BATCH_TEST)
+{
+    using namespace gkr;
+    using F = gkr::M31_field::VectorizedM31;
+    using F_primitive = gkr::M31_field::M31;
+    Config config{};
+
+    // three shapes, the smallest input placed between the two others
+    std::vector<Circuit<F, F_primitive>> circuits(3);
+    std::vector<uint32> nb_layers = {3, 2, 4};
+    std::vector<uint32> nb_input_vars = {6, 3, 5};
+    for (uint32 k = 0; k < circuits.size(); k++)
+    {
+        for (int i = nb_layers[k] - 1; i >= 0; --i)
+        {
+            circuits[k].layers.emplace_back(CircuitLayer<F, F_primitive>::random(nb_input_vars[k] - nb_layers[k] + i, nb_input_vars[k] - nb_layers[k] + i + 1));
+        }
+        circuits[k].evaluate();
+    }
+    BatchInputLayout layout = BatchInputLayout::of(circuits);
+    EXPECT_EQ(layout.offsets, std::vector<uint32>({0, 96, 64}));
+    EXPECT_EQ(layout.nb_vars, 7u);
+
+    std::vector<Circuit<F, F_primitive>> verifier_circuits = circuits;
+    Prover<F, F_primitive> prover(config);
+    prover.prepare_mem(circuits[0]);
+    auto [claimed_v, proof] = prover.prove(circuits);
+    ASSERT_EQ(claimed_v.size(), circuits.size());
+    Verifier verifier(config);
+    EXPECT_TRUE(verifier.verify(verifier_circuits, claimed_v, proof));
+
+    // the batch leaves the scratch pads of prepare_mem to the next single proof
+    auto [claimed_v_single, proof_single] = prover.prove(circuits[0]);
+    EXPECT_TRUE(verifier.verify(verifier_circuits[0], claimed_v_single, proof_single));
+
+    proof.reset();
+    claimed_v[1][0] += F::one();
+    EXPECT_FALSE(verifier.verify(verifier_circuits, claimed_v, proof));
+}
+
+TEST(GKR_TEST, GKR_WITNESS_BATCH_TEST)
+{
+    using namespace gkr;
+    using F = gkr::M31_field::VectorizedM31;
+    using F_primitive = gkr::M31_field::M31;
+    Config config{};
+
+    // a power gate layer without mul gates between two general ones, constants at the input
+    uint32 n_layers = 3;
+    Circuit<F, F_primitive> circuit;
+    for (int i = n_layers - 1; i >= 0; --i)
+    {
+        circuit.layers.emplace_back(CircuitLayer<F, F_primitive>::random(i + 2, i + 3));
+        CircuitLayer<F, F_primitive>& layer = circuit.layers.back();
+        if (i == 1)
+        {
+            layer.mul.sparse_evals.clear();
+            for (uint32 o = 0; o < (1u << layer.nb_output_vars); o++)
+            {
+                uint32 in[1] = {(5 * o + 2) % (1u << layer.nb_input_vars)};
+                layer.pow.sparse_evals.emplace_back(Gate<F_primitive, 1>(o, in, F_primitive::random()));
+            }
+        }
+        if (i == 0)
+        {
+            layer.cst.sparse_evals.emplace_back(ConstGate<F_primitive>{3, F_primitive::random()});
+        }
+        layer.compile();
+    }
+    std::vector<std::vector<F>> witnesses(8);
+    for (std::vector<F>& witness: witnesses)
+    {
+        witness = MultiLinearPoly<F>::random(circuit.log_input_size()).evals;
+    }
+
+    WitnessBatch<F, F_primitive> batch;
+    batch.evaluate(circuit, witnesses);
+    EXPECT_EQ(batch.nb_batch_vars, 3u);
+    circuit.layers[0].input_layer_vals.evals = witnesses[5];
+    circuit.evaluate();
+    const std::vector<F>& out = circuit.layers.back().output_layer_vals.evals;
+    EXPECT_TRUE(std::equal(out.begin(), out.end(), batch.vals.back().begin() + 5 * out.size()));
+
+    Circuit<F, F_primitive> verifier_circuit = circuit;
+    Prover<F, F_primitive> prover(config);
+    auto [claimed_v, proof] = prover.prove(circuit, witnesses);
+    Verifier verifier(config);
+    EXPECT_TRUE(verifier.verify(verifier_circuit, witnesses.size(), claimed_v, proof));
+
+    // one proof for the batch, not one per witness
+    Prover<F, F_primitive> single_prover(config);
+    single_prover.prepare_mem(circuit);
+    Proof<F> single_proof = std::get<1>(single_prover.prove(circuit));
+    EXPECT_LT(proof.bytes.size(), witnesses.size() * single_proof.bytes.size());
+
+    proof.reset();
+    claimed_v[0] += F::one();
+    EXPECT_FALSE(verifier.verify(verifier_circuit, witnesses.size(), claimed_v, proof));
+}
+
+TEST(GKR_TEST, GKR_WITNESS_BATCH_REST_TEST)
+{
+    using namespace gkr;
+    using F = gkr::M31_field::VectorizedM31;
+    using F_primitive = gkr::M31_field::M31;
+
+    // a mul only layer on two witnesses, the part sent between the phases is then zero
+    uint32 nb_batch_vars = 1;
+    CircuitLayer<F, F_primitive> layer = CircuitLayer<F, F_primitive>::random(2, 3);
+    layer.add.sparse_evals.clear();
+    layer.compile();
+    uint32 nb_vars = layer.nb_input_vars;
+    std::vector<F> v, outs;
+    for (uint32 b = 0; b < (1u << nb_batch_vars); b++)
+    {
+        layer.input_layer_vals = MultiLinearPoly<F>::random(nb_vars);
+        v.insert(v.end(), layer.input_layer_vals.evals.begin(), layer.input_layer_vals.evals.end());
+        std::vector<F> out = layer.evaluate();
+        outs.insert(outs.end(), out.begin(), out.end());
+    }
+    std::vector<F_primitive> rz1(layer.nb_output_vars), rz2(layer.nb_output_vars), rb(nb_batch_vars);
+    for (std::vector<F_primitive>* r: {&rz1, &rz2, &rb})
+    {
+        for (F_primitive& r_i: *r)
+        {
+            r_i = F_primitive::random();
+        }
+    }
+    F_primitive alpha = F_primitive::random(), beta = F_primitive::random();
+    F v1 = eval_multilinear(outs, batch_point(rz1, rb)), v2 = eval_multilinear(outs, batch_point(rz2, rb));
+
+    Transcript<F, F_primitive> transcript;
+    sumcheck_prove_gkr_layer_batch(layer, v, nb_batch_vars, rz1, rz2, rb, alpha, beta, transcript);
+    Transcript<F, F_primitive> verifier_transcript;
+    EXPECT_TRUE(std::get<0>(sumcheck_verify_gkr_layer_batch(layer, nb_batch_vars, rz1, rz2, rb, v1, v2, alpha, beta, transcript.proof, verifier_transcript)));
+
+    // a false claim, off by delta. Each round message is shifted by half the error at both points, which
+    // leaves half of it at the challenge. rest is forged so that the errors of both phases cancel in
+    // S + rest, the last sumcheck is then honest.
+    F_primitive delta = F_primitive::random(), inv_2 = F_primitive(2).inv();
+    F_primitive err = delta * alpha;
+    Transcript<F, F_primitive> forged;
+    auto forge_rounds = [&](SumcheckVirtualPolyHelper<F, F_primitive>& helper, const auto& combine)
+    {
+        std::vector<F_primitive> rs;
+        for (uint32 i_var = 0; i_var < nb_vars; i_var++)
+        {
+            std::vector<F> evals = helper.poly_eval_at(i_var, combine);
+            for (F& e: evals)
+            {
+                e = e + err * inv_2;
+            }
+            append_round_message(forged, evals);
+            F_primitive r = forged.challenge_f();
+            helper.receive_challenge(i_var, r, combine);
+            rs.emplace_back(r);
+            err *= inv_2;
+        }
+        return rs;
+    };
+    std::vector<F_primitive> eq_z = _batch_eq_z(layer.nb_output_vars, rz1, rz2, alpha, beta);
+    std::vector<F_primitive> eq_b(1 << nb_batch_vars);
+    _eq_evals_at_primitive(rb, F_primitive::one(), eq_b.data());
+    auto [h, p] = _batch_phase_one_tables(layer, v, eq_z, eq_b);
+    SumcheckVirtualPolyHelper<F, F_primitive> x_helper;
+    x_helper.prepare({v.data(), h.data()}, nb_vars + nb_batch_vars, 2);
+    std::vector<F_primitive> rx = forge_rounds(x_helper, BatchPhaseOneCombine<F>{false, 0});
+    std::vector<F> vx = x_helper.tables[0];
+
+    // with e the error left by phase one, rest = -e / (2^n - 1) leaves (e - rest) / 2^n + rest = 0
+    F_primitive rest = -(err * F_primitive((1 << nb_vars) - 1).inv());
+    forged.append_f(F::zero() + rest);
+    forged.challenge_f();
+    err = err - rest;
+
+    std::vector<F> g = _batch_phase_two_table(layer, vx, rx, eq_z, eq_b);
+    SumcheckVirtualPolyHelper<F, F_primitive> y_helper;
+    y_helper.prepare({v.data(), g.data()}, nb_vars + nb_batch_vars, 2);
+    std::vector<F_primitive> ry = forge_rounds(y_helper, ProductCombine<F>{});
+    EXPECT_EQ(err + rest, F_primitive::zero());
+    std::vector<F> vy = y_helper.tables[0];
+
+    std::vector<F> e(eq_b.size());
+    for (uint32 b = 0; b < eq_b.size(); b++)
+    {
+        e[b] = F::zero() + eq_b[b];
+    }
+    BatchCombine<F, F_primitive> combine{eval_sparse_circuit_connect_poly<F, F_primitive, 2>(layer.mul, rz1, rz2, alpha, beta, {rx, ry}),
+        F_primitive::zero(), F_primitive::zero(), true, false, layer.pow_degree};
+    sumcheck_prove_virtual<F, F_primitive>({e.data(), vx.data(), vy.data()}, nb_batch_vars, combine.degree(), combine, forged);
+
+    Transcript<F, F_primitive> forged_verifier_transcript;
+    EXPECT_FALSE(std::get<0>(sumcheck_verify_gkr_layer_batch(layer, nb_batch_vars, rz1, rz2, rb, v1 + delta, v2, alpha, beta, forged.proof, forged_verifier_transcript)));
+}
+
 TEST(GKR_TEST, GKR_FROM_CIRCUIT_RAW_TEST)
 {
     using namespace gkr;
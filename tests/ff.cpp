@@ -3,6 +3,7 @@
 #include <gtest/gtest.h>
 
 #include "field/M31.hpp"
+#include "field/M31_ext3.hpp"
 
 template <typename F>
 void test_field_op()
@@ -63,6 +64,51 @@ TEST(FF_TESTS, PACKED_MERSEN_EXT_SERIALIZE_TESTS)
     test_serialization<F>();
 }
 
+TEST(FF_TESTS, MERSEN_EXT3_OP_TESTS)
+{
+    srand(4321);
+    using F = gkr::M31_field::M31Ext3;
+    test_field_op<F>();
+}
+
+TEST(FF_TESTS, MERSEN_EXT3_SERIALIZE_TESTS)
+{
+    srand(951);
+    using F = gkr::M31_field::M31Ext3;
+    test_serialization<F>();
+}
+
+TEST(FF_TESTS, PACKED_MERSEN_EXT3_OP_TESTS)
+{
+    srand(2468);
+    using F = gkr::M31_field::VectorizedM31Ext3;
+    test_field_op<F>();
+
+    // the packed-by-scalar product must agree with the packed-by-packed one
+    using F_primitive = gkr::M31_field::M31Ext3;
+    F f = F::random();
+    F_primitive r = F_primitive::random();
+    F r_packed(r.v[0].x, r.v[1].x, r.v[2].x);
+    EXPECT_EQ(f * r, f * r_packed);
+
+    // base field values met by extension ones agree with their embedding
+    using W = gkr::M31_field::VectorizedM31;
+    W w = W::random();
+    W bit = W::random_bool();
+    EXPECT_EQ(w * f, F(w) * f);
+    EXPECT_EQ(w * r, F(w) * r);
+    EXPECT_EQ(w + f, F(w) + f);
+    EXPECT_EQ(mul_by_bit(bit, f), F(bit) * f);
+    EXPECT_EQ(mul_by_bit(bit, r), F(bit) * r);
+}
+
+TEST(FF_TESTS, PACKED_MERSEN_EXT3_SERIALIZE_TESTS)
+{
+    srand(8642);
+    using F = gkr::M31_field::VectorizedM31Ext3;
+    test_serialization<F>();
+}
+
 TEST(FF_TESTS, PACK_UNPACK_TEST)
 {
     srand(753);
@@ -101,3 +147,53 @@ TEST(FF_TESTS, PACK_UNPACK_TEST)
 
     EXPECT_TRUE(same);
 }
+
+template <typename F, typename G>
+void test_accumulator(const F& a_max, const G& b_max)
+{
+    gkr::Accumulator<F> acc;
+    F sum = F::zero();
+    for (unsigned i = 0; i < 10000; i++)
+    {
+        // the largest representatives stress the unreduced lanes
+        F a = i % 2 ? a_max : F::random();
+        G b = i % 3 ? b_max : G::random();
+        acc.mul_add(a, b);
+        sum += a * b;
+        acc.add(a);
+        sum += a;
+    }
+    EXPECT_EQ(acc.result(), sum);
+}
+
+TEST(FF_TESTS, ACCUMULATOR_TEST)
+{
+    srand(753);
+    using namespace gkr::M31_field;
+    M31 m31_max = M31(mod - 1);
+    VectorizedM31 packed_max = VectorizedM31(mod - 1);
+    test_accumulator<M31, M31>(m31_max, m31_max);
+    test_accumulator<VectorizedM31, VectorizedM31>(packed_max, packed_max);
+    test_accumulator<VectorizedM31, M31>(packed_max, m31_max);
+    test_accumulator<M31Ext3, M31>(M31Ext3(mod - 1), m31_max);
+}
+
+TEST(FF_TESTS, SUM_PACKED_TEST)
+{
+    using namespace gkr::M31_field;
+    PackedM31 max = PackedM31(mod - 1);
+    M31 sum = M31::zero();
+    for (size_t i = 0; i < PackedM31::pack_size(); i++)
+    {
+        sum += M31(mod - 1);
+    }
+    EXPECT_EQ(max.sum_packed(), sum);
+
+    PackedM31 x = PackedM31::random();
+    sum = M31::zero();
+    for (const M31 &lane: x.unpack())
+    {
+        sum += lane;
+    }
+    EXPECT_EQ(x.sum_packed(), sum);
+}
@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+
+#include "field/M31.hpp"
+#include "field/M31_ext3.hpp"
+#include "LinearGKR/logup.hpp"
+#include "LinearGKR/LinearGKR.hpp"
+
+using F = gkr::M31_field::VectorizedM31;
+using F_primitive = gkr::M31_field::M31;
+
+// 2^nb_vars packed values, every lane below 2^nb_bits
+std::vector<F> random_limbs(gkr::uint32 nb_vars, gkr::uint32 nb_bits)
+{
+    std::vector<F_primitive> lanes;
+    for (gkr::uint32 i = 0; i < (1u << nb_vars) * F::pack_size(); i++)
+    {
+        lanes.emplace_back(F_primitive(rand() % (1u << nb_bits)));
+    }
+    return F::pack_field_elements(lanes);
+}
+
+TEST(LOGUP_TEST, LOGUP_MULTIPLICITIES)
+{
+    using namespace gkr;
+    LookupTable<F_primitive> table = LookupTable<F_primitive>::range(4);
+    std::vector<F> queries = random_limbs(5, 4);
+    std::vector<F> m = logup_multiplicities(table, queries);
+
+    // every lane counts its own queries
+    std::vector<F_primitive> query_lanes = unpack_lanes<F, F_primitive>(queries);
+    std::vector<F_primitive> m_lanes = unpack_lanes<F, F_primitive>(m);
+    uint32 nb_lanes = F::pack_size();
+    for (uint32 j = 0; j < table.values.size(); j++)
+    {
+        for (uint32 l = 0; l < nb_lanes; l++)
+        {
+            uint32 count = 0;
+            for (uint32 i = l; i < query_lanes.size(); i += nb_lanes)
+            {
+                count += query_lanes[i] == table.values[j];
+            }
+            EXPECT_EQ(m_lanes[j * nb_lanes + l], F_primitive(count));
+        }
+    }
+}
+
+TEST(LOGUP_TEST, LOGUP_PROVE_VERIFY)
+{
+    using namespace gkr;
+    Config config{};
+
+    LookupTable<F_primitive> table = LookupTable<F_primitive>::range(8);
+    // fewer, then more queries than table entries
+    for (uint32 nb_query_vars: {5, 10})
+    {
+        std::vector<F> queries = random_limbs(nb_query_vars, 8);
+        Transcript<F, F_primitive> prover_transcript;
+        auto rq = logup_prove(table, queries, prover_transcript, config);
+        Proof<F> &proof = prover_transcript.proof;
+
+        Transcript<F, F_primitive> verifier_transcript;
+        auto [verified, verifier_rq, vq] = logup_verify(table, nb_query_vars, proof, verifier_transcript, config);
+        EXPECT_TRUE(verified);
+        EXPECT_EQ(verifier_rq, rq);
+        for (int j = 0; j < config.get_num_repetitions(); j++)
+        {
+            EXPECT_EQ(vq[j], eval_multilinear(queries, rq[j]));
+        }
+
+        // a single lane of a single query out of the table
+        std::vector<F_primitive> lanes = unpack_lanes<F, F_primitive>(queries);
+        lanes[3] = F_primitive(1 << 8);
+        queries = F::pack_field_elements(lanes);
+        Transcript<F, F_primitive> prover_transcript_fail;
+        logup_prove(table, queries, prover_transcript_fail, config);
+        Transcript<F, F_primitive> verifier_transcript_fail;
+        EXPECT_FALSE(std::get<0>(logup_verify(table, nb_query_vars, prover_transcript_fail.proof, verifier_transcript_fail, config)));
+    }
+}
+
+TEST(LOGUP_TEST, GKR_WITH_LOOKUP_TEST)
+{
+    using namespace gkr;
+    Config config{};
+
+    // a range check on the input layer, e.g. the limbs of a decomposition
+    uint32 n_layers = 3;
+    Circuit<F, F_primitive> circuit;
+    for (int i = n_layers - 1; i >= 0; --i)
+    {
+        circuit.layers.emplace_back(CircuitLayer<F, F_primitive>::random(i + 3, i + 4));
+    }
+    circuit.layers[0].input_layer_vals.evals = random_limbs(circuit.layers[0].nb_input_vars, 6);
+    circuit.lookup = LookupTable<F_primitive>::range(6);
+    circuit.evaluate();
+
+    Prover<F, F_primitive> prover(config);
+    prover.prepare_mem(circuit);
+    auto [claimed_v, proof] = prover.prove(circuit);
+    Verifier verifier(config);
+    EXPECT_TRUE(verifier.verify(circuit, claimed_v, proof));
+
+    // the same circuit with an input out of range
+    std::vector<F_primitive> lanes = unpack_lanes<F, F_primitive>(circuit.layers[0].input_layer_vals.evals);
+    lanes[5] = F_primitive(1 << 6);
+    circuit.layers[0].input_layer_vals.evals = F::pack_field_elements(lanes);
+    circuit.evaluate();
+    Prover<F, F_primitive> prover_fail(config);
+    prover_fail.prepare_mem(circuit);
+    auto [claimed_v_fail, proof_fail] = prover_fail.prove(circuit);
+    EXPECT_FALSE(verifier.verify(circuit, claimed_v_fail, proof_fail));
+
+    // the witness batch does not run the lookup, a batch proof is only accepted without it
+    Circuit<F, F_primitive> no_lookup = circuit;
+    no_lookup.lookup = LookupTable<F_primitive>();
+    std::vector<std::vector<F>> witnesses(2, circuit.layers[0].input_layer_vals.evals);
+    auto [claimed_v_batch, proof_batch] = prover_fail.prove(no_lookup, witnesses);
+    EXPECT_TRUE(verifier.verify(no_lookup, witnesses.size(), claimed_v_batch, proof_batch));
+    proof_batch.reset();
+    EXPECT_FALSE(verifier.verify(circuit, witnesses.size(), claimed_v_batch, proof_batch));
+}
@@ -2,6 +2,7 @@
 
 #include "LinearGKR/gkr.hpp"
 #include "LinearGKR/sumcheck.hpp"
+#include "LinearGKR/sumcheck_virtual.hpp"
 #include "field/M31.hpp"
 #include "circuit/circuit.hpp"
 
@@ -66,4 +67,147 @@ TEST(SUMCHECK_TEST, SUMCHECK_GKR_LAYER)
     }
     bool not_verified = std::get<0>(sumcheck_verify_gkr_layer(layer, rz1, rz2, claim_v1, claim_v2, alpha, beta, proof, verifier_transcript_fail, config));
     EXPECT_FALSE(not_verified);
-}
\ No newline at end of file
+}
+TEST(SUMCHECK_TEST, GATE_WEIGHTS)
+{
+    using namespace gkr;
+    using F_primitive = M31_field::M31;
+
+    // enough gates for the vectorized loop and a scalar tail
+    uint32 nb_output_vars = 7, nb_input_vars = 6;
+    SparseCircuitConnection<F_primitive, 2> mul;
+    for (uint32 i = 0; i < 3 * 16 + 5; i++)
+    {
+        uint32 i_ids[2] = {static_cast<uint32>(rand()) % (1 << nb_input_vars), static_cast<uint32>(rand()) % (1 << nb_input_vars)};
+        mul.sparse_evals.emplace_back(Gate<F_primitive, 2>(rand() % (1 << nb_output_vars), i_ids, F_primitive::random()));
+    }
+    mul.compile();
+    const GateCSR<F_primitive> &csr = mul.csr<CoefType::General>(0);
+    uint32 nb_gates = csr.o_ids.size();
+
+    std::vector<F_primitive> rz1, rz2, rx;
+    for (uint32 i = 0; i < nb_output_vars; i++)
+    {
+        rz1.emplace_back(F_primitive::random());
+        rz2.emplace_back(F_primitive::random());
+    }
+    for (uint32 i = 0; i < nb_input_vars; i++)
+    {
+        rx.emplace_back(F_primitive::random());
+    }
+    F_primitive alpha = F_primitive::random(), beta = F_primitive::random();
+    std::vector<F_primitive> rz1_halves(2 * eq_sqrt_table_size(nb_output_vars)), rz2_halves(rz1_halves.size()), rx_halves(2 * eq_sqrt_table_size(nb_input_vars));
+    auto eq_rz1 = _eq_evals_sqrt_at(rz1, alpha, rz1_halves.data(), rz1_halves.data() + rz1_halves.size() / 2);
+    auto eq_rz2 = _eq_evals_sqrt_at(rz2, beta, rz2_halves.data(), rz2_halves.data() + rz2_halves.size() / 2);
+    auto eq_rx = _eq_evals_sqrt_at(rx, F_primitive::one(), rx_halves.data(), rx_halves.data() + rx_halves.size() / 2);
+
+    std::vector<F_primitive> eq_rz1_full(1 << nb_output_vars), eq_rz2_full(1 << nb_output_vars), eq_rx_full(1 << nb_input_vars);
+    _eq_evals_at_primitive(rz1, alpha, eq_rz1_full.data());
+    _eq_evals_at_primitive(rz2, beta, eq_rz2_full.data());
+    _eq_evals_at_primitive(rx, F_primitive::one(), eq_rx_full.data());
+
+    std::vector<F_primitive> weights(nb_gates), weights_with_rx(nb_gates);
+    gate_weights<CoefType::General>(csr, 0, nb_gates, eq_rz1, eq_rz2, nullptr, weights.data());
+    gate_weights<CoefType::General>(csr, 0, nb_gates, eq_rz1, eq_rz2, &eq_rx, weights_with_rx.data());
+    for (uint32 i = 0; i < nb_gates; i++)
+    {
+        uint32 z = csr.o_ids[i];
+        F_primitive expected = (eq_rz1_full[z] + eq_rz2_full[z]) * csr.coefs[i];
+        EXPECT_EQ(weights[i], expected);
+        EXPECT_EQ(weights_with_rx[i], expected * eq_rx_full[csr.other_ids[i]]);
+    }
+}
+
+TEST(SUMCHECK_TEST, SUMCHECK_VIRTUAL_POLY)
+{
+    using namespace gkr;
+    using F = M31_field::VectorizedM31;
+    using F_primitive = M31_field::M31;
+
+    // g_0 g_1 g_2 + g_0, large enough to be split across the pool
+    uint32 nb_vars = 13, nb_tables = 3, degree = 3;
+    std::vector<std::vector<F>> tables(nb_tables);
+    std::vector<const F*> table_ptrs;
+    for (auto& table: tables)
+    {
+        table = MultiLinearPoly<F>::random(nb_vars).evals;
+        table_ptrs.emplace_back(table.data());
+    }
+    auto combine = [](const F* g) { return g[0] * g[1] * g[2] + g[0]; };
+    F claimed_sum = F::zero();
+    for (uint32 x = 0; x < (1u << nb_vars); x++)
+    {
+        F g[3] = {tables[0][x], tables[1][x], tables[2][x]};
+        claimed_sum += combine(g);
+    }
+
+    for (uint32 nb_threads: {1, 4})
+    {
+        ThreadPool* pool = nb_threads > 1 ? new ThreadPool(nb_threads) : nullptr;
+        Transcript<F, F_primitive> prover_transcript;
+        auto [rs, evals] = sumcheck_prove_virtual(table_ptrs, nb_vars, degree, combine, prover_transcript, pool);
+        delete pool;
+        for (uint32 k = 0; k < nb_tables; k++)
+        {
+            EXPECT_EQ(evals[k], eval_multilinear(tables[k], rs));
+        }
+
+        Proof<F>& proof = prover_transcript.proof;
+        Transcript<F, F_primitive> verifier_transcript;
+        auto [verified, verifier_rs, verifier_evals] = sumcheck_verify_virtual(nb_vars, nb_tables, degree, claimed_sum, combine, proof, verifier_transcript);
+        EXPECT_TRUE(verified);
+        EXPECT_EQ(verifier_rs, rs);
+        EXPECT_EQ(verifier_evals, evals);
+
+        proof.reset();
+        Transcript<F, F_primitive> verifier_transcript_fail;
+        EXPECT_FALSE(std::get<0>(sumcheck_verify_virtual(nb_vars, nb_tables, degree, claimed_sum + F::one(), combine, proof, verifier_transcript_fail)));
+    }
+}
+
+TEST(SUMCHECK_TEST, SUMCHECK_MULTILINEAR_FINAL_EVAL)
+{
+    using namespace gkr;
+    using F = M31_field::VectorizedM31;
+    using F_primitive = M31_field::M31;
+
+    uint32 nb_vars = 4;
+    MultiLinearPoly<F> poly = MultiLinearPoly<F>::random(nb_vars);
+    F claimed_sum = F::zero();
+    for (const F& v: poly.evals)
+    {
+        claimed_sum += v;
+    }
+
+    // the honest messages f(r_0, ..., r_{i - 1}, t, x) summed over x for t = 0, 1
+    SumcheckProof<F> proof;
+    Transcript<F, F_primitive> prover_transcript;
+    std::vector<F> f = poly.evals;
+    for (uint32 i_var = 0; i_var < nb_vars; i_var++)
+    {
+        F p0 = F::zero(), p1 = F::zero();
+        for (uint32 i = 0; i < f.size() / 2; i++)
+        {
+            p0 += f[2 * i];
+            p1 += f[2 * i + 1];
+        }
+        proof.low_degree_poly_evals.push_back({p0, p1});
+        prover_transcript.append_f(p0);
+        prover_transcript.append_f(p1);
+        F_primitive r = prover_transcript.challenge_f();
+        for (uint32 i = 0; i < f.size() / 2; i++)
+        {
+            f[i] = f[2 * i] + (f[2 * i + 1] - f[2 * i]) * r;
+        }
+        f.resize(f.size() / 2);
+    }
+    Transcript<F, F_primitive> verifier_transcript;
+    EXPECT_TRUE(sumcheck_verify_multilinear(poly, claimed_sum, proof, verifier_transcript));
+
+    // consistent rounds that do not end at poly(r) are rejected by the final check
+    MultiLinearPoly<F> other = poly;
+    other.evals[0] += F::one();
+    other.evals[1] -= F::one();
+    Transcript<F, F_primitive> verifier_transcript_fail;
+    EXPECT_FALSE(sumcheck_verify_multilinear(other, claimed_sum, proof, verifier_transcript_fail));
+}